@@ -11,14 +11,24 @@ namespace SourceEngine
 {
 ErrorOr<BSP> BSP::try_parse(Core::Stream::SeekableStream& stream)
 {
+    BSP bsp;
+
+    // We keep the whole file around, as we need to send it to clients, and the lumps can just point into it
+    auto size = TRY(stream.seek(0, Core::Stream::SeekMode::FromEndPosition));
+    if (static_cast<size_t>(size) < header_size)
+        return Error::from_string_literal("Not enough bytes for a BSP header");
+
+    bsp.m_bytes = TRY(ByteBuffer::create_uninitialized(size));
+    TRY(stream.seek(0, Core::Stream::SeekMode::SetPosition));
+    TRY(stream.read(bsp.m_bytes.bytes()));
+    TRY(stream.seek(0, Core::Stream::SeekMode::SetPosition));
+
     u32 signature;
     TRY(stream >> signature);
 
     if (signature != BSP::signature)
         return Error::from_string_literal("Invalid BSP signature");
 
-    BSP bsp;
-
     TRY(stream >> bsp.m_version);
 
     for (auto i = 0; i < number_of_lumps; i++)
@@ -33,13 +43,10 @@ ErrorOr<BSP> BSP::try_parse(Core::Stream::SeekableStream& stream)
         TRY(stream >> lump.m_version);
         TRY(stream >> lump.m_uncompressed_size);
 
-        lump.m_data = TRY(ByteBuffer::create_uninitialized(length));
+        if (static_cast<u64>(offset) + length > bsp.m_bytes.size())
+            return Error::from_string_literal("BSP lump goes past the end of the file");
 
-        // FIXME: Do we need this tell? Does seek return the position _before_ or _after_ seeking?
-        auto position_to_return_to = TRY(stream.tell());
-        TRY(stream.seek(offset, Core::Stream::SeekMode::SetPosition));
-        TRY(stream.read(lump.m_data.bytes()));
-        TRY(stream.seek(position_to_return_to, Core::Stream::SeekMode::SetPosition));
+        lump.m_data = bsp.m_bytes.bytes().slice(offset, length);
 
         bsp.m_lumps[i] = move(lump);
     }
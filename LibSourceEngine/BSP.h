@@ -8,6 +8,7 @@
 
 #include <AK/ByteBuffer.h>
 #include <AK/Error.h>
+#include <AK/Noncopyable.h>
 #include <AK/Stream.h>
 #include <AK/Types.h>
 #include <LibCore/Stream.h>
@@ -17,7 +18,13 @@ namespace SourceEngine
 {
 class BSP
 {
+    // A copy's lumps would still point into the original's bytes
+    AK_MAKE_NONCOPYABLE(BSP);
+
 public:
+    BSP(BSP&&) = default;
+    BSP& operator=(BSP&&) = default;
+
     static constexpr u32 number_of_lumps = 64;
 
     class Lump
@@ -91,11 +98,12 @@ public:
             OverlayFades
         };
 
-        const ByteBuffer& data() const { return m_data; }
+        // This points into the BSP's bytes, so it's only valid for as long as the BSP is.
+        ReadonlyBytes data() const { return m_data; }
         u32 version() const { return m_version; }
 
     private:
-        ByteBuffer m_data;
+        ReadonlyBytes m_data;
         u32 m_version{};
         u32 m_uncompressed_size{};
     };
@@ -104,6 +112,8 @@ public:
 
     u32 version() const { return m_version; }
     u32 map_revision() const { return m_map_revision; }
+    // The whole file, as it was read, which is what we send to clients who don't have the map.
+    ReadonlyBytes bytes() const { return m_bytes; }
     const Array<Lump, number_of_lumps>& lumps() const { return m_lumps; }
     const Lump& lump(Lump::Type type) const { return m_lumps[static_cast<size_t>(type)]; }
 
@@ -111,8 +121,14 @@ public:
     Crypto::Hash::MD5::DigestType calculate_md5_hash() const;
 
 private:
+    BSP() = default;
+
     static constexpr u32 signature = 0x50534256;
+    // The signature, version, every lump's offset, length, version and uncompressed size, and the map revision
+    static constexpr size_t header_size = sizeof(u32) * (3 + number_of_lumps * 4);
 
+    // The lumps point into this, which is always large enough to be on the heap, so they stay valid when we're moved
+    ByteBuffer m_bytes;
     u32 m_version{};
     Array<Lump, number_of_lumps> m_lumps{};
     u32 m_map_revision{};
@@ -6,14 +6,65 @@
 
 #pragma once
 
+#include <AK/Array.h>
+#include <AK/BitCast.h>
 #include <AK/ByteBuffer.h>
+#include <AK/Endian.h>
 #include <AK/Error.h>
 #include <AK/String.h>
+#include <AK/StringView.h>
 #include <AK/Types.h>
 #include <AK/Vector.h>
 
 namespace SourceEngine
 {
+namespace Detail
+{
+// Copies whole bytes out of source, starting bit_offset (1 to 7) bits into the first byte. Each destination byte is
+// made of the top of one source byte and the bottom of the next, so source must have destination.size() + 1 bytes.
+ALWAYS_INLINE void copy_bytes_from_unaligned_bits(ReadonlyBytes source, u8 bit_offset, Bytes destination)
+{
+    size_t i = 0;
+
+    // Shift and merge a whole word at a time
+    for (; i + sizeof(u64) <= destination.size(); i += sizeof(u64))
+    {
+        u64 low;
+        __builtin_memcpy(&low, source.data() + i, sizeof(low));
+        low = AK::convert_between_host_and_little_endian(low);
+        u64 high = source.data()[i + sizeof(u64)];
+
+        auto word = AK::convert_between_host_and_little_endian((low >> bit_offset) | (high << (64 - bit_offset)));
+        __builtin_memcpy(destination.data() + i, &word, sizeof(word));
+    }
+
+    for (; i < destination.size(); i++)
+        destination.data()[i] = (source.data()[i] >> bit_offset) | (source.data()[i + 1] << (8 - bit_offset));
+}
+}
+
+// Some bits inside of some bytes, which don't have to start or end on a byte boundary. This lets us refer to part of
+// a packet without copying it out.
+class BitSpan
+{
+public:
+    BitSpan() = default;
+    BitSpan(ReadonlyBytes bytes, size_t offset_in_bits, size_t size_in_bits)
+        : m_bytes(bytes), m_offset_in_bits(offset_in_bits), m_size_in_bits(size_in_bits)
+    {
+    }
+
+    ReadonlyBytes bytes() const { return m_bytes; }
+    size_t offset_in_bits() const { return m_offset_in_bits; }
+    size_t size_in_bits() const { return m_size_in_bits; }
+    bool is_empty() const { return m_size_in_bits == 0; }
+
+private:
+    ReadonlyBytes m_bytes;
+    size_t m_offset_in_bits{};
+    size_t m_size_in_bits{};
+};
+
 class BitStream
 {
 public:
@@ -21,28 +72,21 @@ public:
     // seekable or readable and seekable, we just have inheritors implement them always. If they can't support them,
     // then error. Not great but better than having many classes to represent the different variations of streams, and
     // for methods that sometimes want a stream that can seek.
-    ALWAYS_INLINE virtual ErrorOr<size_t> position() const = 0;
-    ALWAYS_INLINE virtual ErrorOr<void> set_position(size_t) = 0;
+    virtual ErrorOr<size_t> position() const = 0;
+    virtual ErrorOr<void> set_position(size_t) = 0;
 };
 
-class ReadableBitStream : public BitStream
+// Everything that can be built on top of read_bits() lives here, so that it can be statically dispatched to the
+// concrete stream (Self) instead of going through a virtual call for every field. ReadableBitStream uses itself as
+// Self, which is the fallback for when we only have a ReadableBitStream&.
+template<typename Self>
+class BitStreamReader
 {
 public:
-    // Reads a single bit
-    ALWAYS_INLINE virtual ErrorOr<bool> read() = 0;
-
     template<typename T>
     ALWAYS_INLINE ErrorOr<T> read_typed(u8 number_of_bits = sizeof(T) << 3) requires(IsIntegral<T>)
     {
-        T value = 0;
-
-        for (auto i = 0; i < number_of_bits; ++i)
-        {
-            if (TRY(read()))
-                value |= (1 << i);
-        }
-
-        return value;
+        return static_cast<T>(TRY(self().read_bits(number_of_bits)));
     }
 
     // FIXME: This should be IsFloatintPoint<T> but double had some problems with always being nan. Because we
@@ -52,72 +96,156 @@ public:
     {
         // FIXME: Is this okay to do?
         //        Conditional<sizeof(T) == 4, u32, u64> value = 0;
-        u32 value = 0;
-
-        for (auto i = 0; i < number_of_bits; ++i)
-        {
-            if (TRY(read()))
-                value |= (1 << i);
-        }
+        auto value = static_cast<u32>(TRY(self().read_bits(number_of_bits)));
 
-        // FIXME: This kinda sucks! Must we reinterpret cast and then deref in order to get the floating point value
-        //        without conversion?
-        return *reinterpret_cast<T*>(&value);
+        return bit_cast<T>(value);
     }
 
     ALWAYS_INLINE ErrorOr<ByteBuffer> read_bytes(size_t number_of_bytes)
     {
         auto buffer = TRY(ByteBuffer::create_uninitialized(number_of_bytes));
-        for (auto i = 0; i < number_of_bytes; i++)
-            buffer.data()[i] = TRY(read_typed<u8>());
+        TRY(self().read_bytes(buffer.bytes()));
 
         return buffer;
     }
 
-    ALWAYS_INLINE ErrorOr<void> read_bytes(Bytes bytes)
+    // The Engine never reads more than 5 bytes of a varint, whether or not the last one says there's more to come.
+    ALWAYS_INLINE ErrorOr<u32> read_varint()
     {
-        for (auto i = 0; i < bytes.size(); i++)
-            bytes.data()[i] = TRY(read_typed<u8>());
+        if constexpr (requires(Self& stream) {
+                          stream.peek_bits(0);
+                          stream.skip(0);
+                      })
+        {
+            // Look at all 5 bytes it could be at once. If we're near the end, what's past it reads as zero, which
+            // stops the varint, and skip() will tell us if we actually went past the end.
+            auto window = self().peek_bits(max_varint_bytes << 3);
 
-        return {};
+            // The first byte without its continuation bit set is the last one
+            auto stop_bits = ~window & 0x8080808080;
+            auto number_of_bytes = stop_bits != 0 ? (__builtin_ctzll(stop_bits) >> 3) + 1 : max_varint_bytes;
+            window &= (static_cast<u64>(1) << (number_of_bytes << 3)) - 1;
+
+            // Squeeze the 7 bits each byte holds back together
+            auto result = (window & 0x7F) | ((window >> 1) & (0x7F << 7)) | ((window >> 2) & (0x7F << 14)) |
+                          ((window >> 3) & (0x7F << 21)) | ((window >> 4) & (static_cast<u64>(0x7F) << 28));
+
+            TRY(self().skip(number_of_bytes << 3));
+
+            return static_cast<u32>(result);
+        }
+        else
+        {
+            u32 result = 0;
+            int count = 0;
+            u32 byte;
+
+            do
+            {
+                if (count == max_varint_bytes)
+                    return result;
+
+                byte = TRY(read_typed<u8>());
+                result |= (byte & 0x7F) << (7 * count);
+                ++count;
+            } while (byte & 0x80);
+
+            return result;
+        }
     }
 
-    // FIXME: Implement this better? This one is straight from the Engine and might suck
-    // TODO: Might be nice to template this, don't need it yet though
-    ALWAYS_INLINE ErrorOr<u32> read_varint()
+    // Signed varints are zig-zag encoded, so that small negative numbers stay small.
+    ALWAYS_INLINE ErrorOr<i32> read_signed_varint()
+    {
+        auto value = TRY(read_varint());
+        return static_cast<i32>((value >> 1) ^ -(value & 1));
+    }
+
+    // Reads a null-terminated string without allocating. Streams that can will give back a view of the string where it
+    // already is, otherwise it's copied into scratch, which is then advanced past it.
+    ALWAYS_INLINE ErrorOr<StringView> read_string_view(Bytes& scratch)
     {
-        u32 result = 0;
-        int count = 0;
-        u32 byte;
+        size_t length = 0;
 
-        do
+        while (true)
         {
-            if (count == 5)
-                return result;
+            auto c = static_cast<u8>(TRY(self().read_bits(8)));
+            if (c == '\0')
+                break;
 
-            byte = TRY(read_typed<u8>());
-            result |= (byte & 0x7F) << (7 * count);
-            ++count;
-        } while (byte & 0x80);
+            if (length == scratch.size())
+                return Error::from_string_literal("String does not fit in scratch buffer");
 
-        return result;
+            scratch.data()[length++] = c;
+        }
+
+        StringView value(reinterpret_cast<const char*>(scratch.data()), length);
+        scratch = scratch.slice(length);
+
+        return value;
+    }
+
+    // The same as read_string_view, but for a known number of bytes.
+    ALWAYS_INLINE ErrorOr<ReadonlyBytes> read_bytes_view(size_t number_of_bytes, Bytes& scratch)
+    {
+        if (number_of_bytes > scratch.size())
+            return Error::from_string_literal("Bytes do not fit in scratch buffer");
+
+        auto bytes = scratch.slice(0, number_of_bytes);
+        TRY(self().read_bytes(bytes));
+        scratch = scratch.slice(number_of_bytes);
+
+        return bytes;
     }
+
+private:
+    static constexpr u8 max_varint_bytes = 5;
+
+    ALWAYS_INLINE Self& self() { return static_cast<Self&>(*this); }
 };
 
-class WritableBitStream : public BitStream
+class ReadableBitStream : public BitStream, public BitStreamReader<ReadableBitStream>
 {
 public:
-    // Writes a single bit
-    ALWAYS_INLINE virtual ErrorOr<void> write(bool value) = 0;
+    using BitStreamReader<ReadableBitStream>::read_bytes;
 
-    template<typename T>
-    ALWAYS_INLINE ErrorOr<void> write_typed(T value, u8 number_of_bits = sizeof(T) << 3) requires(IsIntegral<T>)
+    // Reads a single bit
+    virtual ErrorOr<bool> read() = 0;
+
+    // Reads up to 64 bits, with the first bit read being the least significant bit of the value. Inheritors that have
+    // something better to do than going bit by bit should override this.
+    virtual ErrorOr<u64> read_bits(u8 number_of_bits)
     {
+        u64 value = 0;
+
         for (auto i = 0; i < number_of_bits; ++i)
-            TRY(write((value & (1 << i)) != 0));
+        {
+            if (TRY(read()))
+                value |= static_cast<u64>(1) << i;
+        }
+
+        return value;
+    }
+
+    virtual ErrorOr<void> read_bytes(Bytes bytes)
+    {
+        for (auto i = 0; i < bytes.size(); i++)
+            bytes.data()[i] = TRY(read_typed<u8>());
 
         return {};
     }
+};
+
+// The same as BitStreamReader, but for everything that can be built on top of write_bits().
+template<typename Self>
+class BitStreamWriter
+{
+public:
+    template<typename T>
+    ALWAYS_INLINE ErrorOr<void> write_typed(T value, u8 number_of_bits = sizeof(T) << 3) requires(IsIntegral<T>)
+    {
+        return self().write_bits(static_cast<u64>(value), number_of_bits);
+    }
 
     // FIXME: This should be IsFloatintPoint<T> but double had some problems with always being nan. Because we
     //        read/write doubles yet we'll fix it when we need it.
@@ -125,57 +253,208 @@ public:
     ALWAYS_INLINE ErrorOr<void> write_typed(T value, u8 number_of_bits = sizeof(T) << 3) requires(IsSame<T, float>)
     {
         // FIXME: Is this okay to do?
-        //        auto value_integral = *reinterpret_cast<Conditional<sizeof(T) == 4, u32*, u64*>>(&value);
-        auto value_integral = *reinterpret_cast<u32*>(&value);
+        //        auto value_integral = bit_cast<Conditional<sizeof(T) == 4, u32, u64>>(value);
+        auto value_integral = bit_cast<u32>(value);
+
+        return self().write_bits(value_integral, number_of_bits);
+    }
+
+    ALWAYS_INLINE ErrorOr<void> write_varint(u32 value)
+    {
+        // Every byte holds 7 bits of the value, so find out how many bytes we need from how many bits are significant
+        auto number_of_significant_bits = 32 - __builtin_clz(value | 1);
+        auto number_of_bytes = (number_of_significant_bits + 6) / 7;
 
+        // Spread the value out 7 bits to a byte, and set the continuation bit on all of them except for the last one
+        auto encoded = (value & 0x7F) | ((value & (0x7F << 7)) << 1) | ((value & (0x7F << 14)) << 2) |
+                       ((value & (0x7F << 21)) << 3) | ((static_cast<u64>(value) >> 28) << 32);
+        encoded |= 0x80808080 & ((static_cast<u64>(1) << ((number_of_bytes - 1) << 3)) - 1);
+
+        return self().write_bits(encoded, number_of_bytes << 3);
+    }
+
+    // See BitStreamReader::read_signed_varint.
+    ALWAYS_INLINE ErrorOr<void> write_signed_varint(i32 value)
+    {
+        return write_varint((static_cast<u32>(value) << 1) ^ static_cast<u32>(value >> 31));
+    }
+
+private:
+    ALWAYS_INLINE Self& self() { return static_cast<Self&>(*this); }
+};
+
+class WritableBitStream : public BitStream, public BitStreamWriter<WritableBitStream>
+{
+public:
+    // Writes a single bit
+    virtual ErrorOr<void> write(bool value) = 0;
+
+    // Writes the lower number_of_bits (up to 64) of value, least significant bit first. Inheritors that have something
+    // better to do than going bit by bit should override this.
+    virtual ErrorOr<void> write_bits(u64 value, u8 number_of_bits)
+    {
         for (auto i = 0; i < number_of_bits; ++i)
-            TRY(write((value_integral & (1 << i)) != 0));
+            TRY(write((value & (static_cast<u64>(1) << i)) != 0));
 
         return {};
     }
 
-    ALWAYS_INLINE ErrorOr<void> write_bytes(ReadonlyBytes bytes)
+    virtual ErrorOr<void> write_bytes(ReadonlyBytes bytes)
     {
         for (auto b : bytes)
             TRY(write_typed(b));
 
         return {};
     }
+};
 
-    ALWAYS_INLINE ErrorOr<void> write_varint(u32 value)
+class MemoryBitStream final : public ReadableBitStream,
+                              public WritableBitStream,
+                              public BitStreamReader<MemoryBitStream>,
+                              public BitStreamWriter<MemoryBitStream>
+{
+public:
+    using BitStreamReader<MemoryBitStream>::read_bytes;
+    using BitStreamReader<MemoryBitStream>::read_typed;
+    using BitStreamReader<MemoryBitStream>::read_signed_varint;
+    using BitStreamReader<MemoryBitStream>::read_varint;
+    using BitStreamWriter<MemoryBitStream>::write_signed_varint;
+    using BitStreamWriter<MemoryBitStream>::write_typed;
+    using BitStreamWriter<MemoryBitStream>::write_varint;
+
+    explicit MemoryBitStream(Bytes bytes) : m_bytes(bytes), m_size_in_bits(bytes.size() << 3) {}
+    explicit MemoryBitStream(ReadonlyBytes bytes) : m_bytes(bytes), m_size_in_bits(bytes.size() << 3) {}
+
+    // Reads only the bits that the span covers. Positions are still from the beginning of the span's bytes, so this
+    // starts at span.offset_in_bits().
+    explicit MemoryBitStream(BitSpan span)
+        : m_bytes(span.bytes()), m_current_bit(span.offset_in_bits()),
+          m_size_in_bits(span.offset_in_bits() + span.size_in_bits())
+    {
+    }
+
+    ALWAYS_INLINE ErrorOr<bool> read() override { return TRY(read_bits(1)) != 0; }
+
+    ALWAYS_INLINE ErrorOr<u64> read_bits(u8 number_of_bits) override
     {
-        while (value > 0x7F)
+        // A refill may start on any bit of a byte, so we can only promise so many bits out of a 64-bit window
+        if (number_of_bits > max_bits_per_refill)
         {
-            TRY(write_typed<u8>((value & 0x7F) | 0x80));
-            value >>= 7;
+            auto low = TRY(read_bits_from_window(32));
+            auto high = TRY(read_bits_from_window(number_of_bits - 32));
+            return low | (high << 32);
         }
 
-        TRY(write_typed(value & 0x7F));
+        return read_bits_from_window(number_of_bits);
+    }
+
+    ErrorOr<void> read_bytes(Bytes destination) override
+    {
+        if (destination.is_empty())
+            return {};
+
+        auto bytes = readonly_bytes();
+
+        auto number_of_bits = destination.size() << 3;
+        if (m_current_bit + number_of_bits > m_size_in_bits)
+            return Error::from_string_literal("Cannot read out of bounds");
+
+        auto index = m_current_bit >> 3;
+        auto bit_offset = m_current_bit & 7;
+
+        if (bit_offset == 0)
+            __builtin_memcpy(destination.data(), bytes.data() + index, destination.size());
+        else
+            Detail::copy_bytes_from_unaligned_bits(bytes.slice(index), bit_offset, destination);
+
+        m_current_bit += number_of_bits;
+        m_window_bits = 0;
 
         return {};
     }
-};
 
-class MemoryBitStream final : public ReadableBitStream, public WritableBitStream
-{
-public:
-    explicit MemoryBitStream(Bytes bytes) : m_bytes(bytes) {}
-    explicit MemoryBitStream(ReadonlyBytes bytes) : m_bytes(bytes) {}
-
-    ALWAYS_INLINE ErrorOr<bool> read() override
+    ErrorOr<StringView> read_string_view(Bytes& scratch)
     {
         auto bytes = readonly_bytes();
 
+        if (m_current_bit >= m_size_in_bits)
+            return Error::from_string_literal("Cannot read out of bounds");
+
         auto index = m_current_bit >> 3;
-        if (index >= bytes.size())
+        auto bit_offset = m_current_bit & 7;
+
+        if (bit_offset == 0)
+        {
+            // We're on a byte boundary, so the string is already laid out in memory for us
+            auto remaining_bytes = bytes.slice(index, (m_size_in_bits - m_current_bit) >> 3);
+            auto* terminator =
+                static_cast<const u8*>(__builtin_memchr(remaining_bytes.data(), '\0', remaining_bytes.size()));
+
+            if (!terminator)
+                return Error::from_string_literal("Cannot read out of bounds");
+
+            auto length = static_cast<size_t>(terminator - remaining_bytes.data());
+            m_current_bit += (length + 1) << 3;
+            m_window_bits = 0;
+
+            return StringView(reinterpret_cast<const char*>(remaining_bytes.data()), length);
+        }
+
+        // Otherwise, shift it into scratch a chunk at a time, and look for the terminator there
+        auto number_of_whole_bytes_remaining = (m_size_in_bits - m_current_bit) >> 3;
+        size_t length = 0;
+
+        while (true)
+        {
+            auto chunk_size =
+                min(min(string_chunk_size, number_of_whole_bytes_remaining - length), scratch.size() - length);
+
+            if (chunk_size == 0)
+            {
+                if (length == number_of_whole_bytes_remaining)
+                    return Error::from_string_literal("Cannot read out of bounds");
+
+                return Error::from_string_literal("String does not fit in scratch buffer");
+            }
+
+            auto chunk = scratch.slice(length, chunk_size);
+            Detail::copy_bytes_from_unaligned_bits(bytes.slice(index + length), bit_offset, chunk);
+
+            auto* terminator = static_cast<const u8*>(__builtin_memchr(chunk.data(), '\0', chunk.size()));
+            if (terminator)
+            {
+                length += terminator - chunk.data();
+                break;
+            }
+
+            length += chunk_size;
+        }
+
+        m_current_bit += (length + 1) << 3;
+        m_window_bits = 0;
+
+        StringView value(reinterpret_cast<const char*>(scratch.data()), length);
+        scratch = scratch.slice(length);
+
+        return value;
+    }
+
+    ErrorOr<ReadonlyBytes> read_bytes_view(size_t number_of_bytes, Bytes& scratch)
+    {
+        // We can only hand out a view of our own bytes if they're laid out the same as they would be in scratch
+        if ((m_current_bit & 7) != 0)
+            return BitStreamReader<MemoryBitStream>::read_bytes_view(number_of_bytes, scratch);
+
+        auto bytes = readonly_bytes();
+
+        if (m_current_bit + (number_of_bytes << 3) > m_size_in_bits)
             return Error::from_string_literal("Cannot read out of bounds");
 
-        // We index the pointer directly instead of using the Bytes (Span<u8>) indexer as we don't want to incur a
-        // second bounds check
-        auto value = bytes.data()[index] >> (m_current_bit & 7);
+        auto view = bytes.slice(m_current_bit >> 3, number_of_bytes);
+        m_current_bit += number_of_bytes << 3;
+        m_window_bits = 0;
 
-        ++m_current_bit;
-        return value & 1;
+        return view;
     }
 
     ALWAYS_INLINE ErrorOr<void> write(bool value) override
@@ -186,7 +465,7 @@ public:
         auto bytes = m_bytes.get<Bytes>();
 
         auto index = m_current_bit >> 3;
-        if (index >= bytes.size())
+        if (m_current_bit >= m_size_in_bits)
             return Error::from_string_literal("Cannot write out of bounds");
 
         if (value)
@@ -195,6 +474,8 @@ public:
             bytes.data()[index] &= ~(1 << (m_current_bit & 7));
 
         ++m_current_bit;
+        // We might have just written over something we had buffered
+        m_window_bits = 0;
 
         return {};
     }
@@ -203,12 +484,11 @@ public:
 
     ALWAYS_INLINE ErrorOr<void> set_position(size_t position) override
     {
-        auto bytes = readonly_bytes();
-
-        if ((position >> 3) >= bytes.size())
+        if (position >= m_size_in_bits)
             return Error::from_string_literal("Cannot set position out of bounds");
 
         m_current_bit = position;
+        m_window_bits = 0;
         return {};
     }
 
@@ -221,47 +501,214 @@ public:
                              [](Bytes value) -> ReadonlyBytes { return value; });
     }
 
-    ALWAYS_INLINE ErrorOr<void> skip(size_t number_of_bits)
+    ALWAYS_INLINE size_t size_in_bits() const { return m_size_in_bits; }
+
+    // Gives back the next number_of_bits (up to max_bits_per_refill) without consuming them. Anything past the end
+    // reads as zero, so skip() over what was actually used to find out if it was there.
+    ALWAYS_INLINE u64 peek_bits(u8 number_of_bits)
     {
-        auto bytes = readonly_bytes();
+        if (number_of_bits > m_window_bits)
+            refill();
 
+        return m_window & ((static_cast<u64>(1) << number_of_bits) - 1);
+    }
+
+    ALWAYS_INLINE ErrorOr<void> skip(size_t number_of_bits)
+    {
         auto target_current_bit = m_current_bit + number_of_bits;
-        if ((target_current_bit >> 3) > bytes.size())
+        if (target_current_bit > m_size_in_bits)
             return Error::from_string_literal("Cannot skip out of bounds");
 
+        // Skipping within what we have buffered doesn't need to throw the window away
+        if (number_of_bits < m_window_bits)
+        {
+            m_window >>= number_of_bits;
+            m_window_bits -= number_of_bits;
+        }
+        else
+        {
+            m_window_bits = 0;
+        }
+
         m_current_bit = target_current_bit;
 
         return {};
     }
 
 private:
+    static constexpr u8 max_bits_per_refill = 64 - 7;
+    static constexpr size_t string_chunk_size = 64;
+
+    ALWAYS_INLINE ErrorOr<u64> read_bits_from_window(u8 number_of_bits)
+    {
+        if (number_of_bits > m_window_bits)
+        {
+            refill();
+
+            if (number_of_bits > m_window_bits)
+                return Error::from_string_literal("Cannot read out of bounds");
+        }
+
+        auto value = m_window & ((static_cast<u64>(1) << number_of_bits) - 1);
+        m_window >>= number_of_bits;
+        m_window_bits -= number_of_bits;
+        m_current_bit += number_of_bits;
+
+        return value;
+    }
+
+    // Buffers the next (up to) 64 bits from the current position into m_window, with only a single bounds check.
+    ALWAYS_INLINE void refill()
+    {
+        auto bytes = readonly_bytes();
+
+        auto index = m_current_bit >> 3;
+        auto bit_offset = m_current_bit & 7;
+
+        u64 window = 0;
+        size_t number_of_bytes_in_window = 0;
+
+        if (index + sizeof(window) <= bytes.size())
+        {
+            __builtin_memcpy(&window, bytes.data() + index, sizeof(window));
+            window = AK::convert_between_host_and_little_endian(window);
+            number_of_bytes_in_window = sizeof(window);
+        }
+        else if (index < bytes.size())
+        {
+            // We're near the end, so take whatever is left
+            number_of_bytes_in_window = bytes.size() - index;
+            for (size_t i = 0; i < number_of_bytes_in_window; i++)
+                window |= static_cast<u64>(bytes.data()[index + i]) << (i << 3);
+        }
+
+        if (number_of_bytes_in_window == 0)
+        {
+            m_window_bits = 0;
+            return;
+        }
+
+        m_window = window >> bit_offset;
+        m_window_bits = (number_of_bytes_in_window << 3) - bit_offset;
+
+        // Our bytes may go on past where we're supposed to stop
+        if (m_current_bit + m_window_bits > m_size_in_bits)
+        {
+            m_window_bits = m_size_in_bits - m_current_bit;
+            m_window &= (static_cast<u64>(1) << m_window_bits) - 1;
+        }
+    }
+
     Variant<ReadonlyBytes, Bytes> m_bytes;
     size_t m_current_bit{};
+    // Where we have to stop reading, which is usually the end of m_bytes
+    size_t m_size_in_bits{};
+    // The bits starting from m_current_bit, least significant bit first. Only the lower m_window_bits are valid.
+    u64 m_window{};
+    u8 m_window_bits{};
 };
 
-class ExpandingBitStream final : public WritableBitStream
+class ExpandingBitStream final : public WritableBitStream, public BitStreamWriter<ExpandingBitStream>
 {
 public:
+    using BitStreamWriter<ExpandingBitStream>::write_signed_varint;
+    using BitStreamWriter<ExpandingBitStream>::write_typed;
+    using BitStreamWriter<ExpandingBitStream>::write_varint;
+
     ExpandingBitStream() {}
+    // Writes over whatever bytes has in it, so if we don't end on a byte boundary, the rest of the last byte is
+    // whatever was there before.
     explicit ExpandingBitStream(ByteBuffer&& bytes) : m_bytes(move(bytes)) {}
 
-    ALWAYS_INLINE ErrorOr<void> write(bool value) override
+    ALWAYS_INLINE ErrorOr<void> write(bool value) override { return write_bits(value, 1); }
+
+    ALWAYS_INLINE ErrorOr<void> write_bits(u64 value, u8 number_of_bits) override
     {
-        auto index = m_current_bit >> 3;
-        auto* value_at_index = TRY(at(index));
+        auto accumulator_index = (m_current_bit - m_accumulator_bits) >> 3;
 
-        if (value)
-            *value_at_index |= 1 << (m_current_bit & 7);
-        else
-            *value_at_index &= ~(1 << (m_current_bit & 7));
+        // Make sure we always have room for the word we may flush, and the partial one we may leave behind
+        if (accumulator_index + (sizeof(m_accumulator) << 1) > m_bytes.size())
+            TRY(grow(accumulator_index + (sizeof(m_accumulator) << 1)));
 
-        ++m_current_bit;
+        if (number_of_bits < 64)
+            value &= (static_cast<u64>(1) << number_of_bits) - 1;
+
+        auto free_bits = 64 - m_accumulator_bits;
+        m_accumulator |= value << m_accumulator_bits;
+        m_current_bit += number_of_bits;
+
+        if (number_of_bits < free_bits)
+        {
+            m_accumulator_bits += number_of_bits;
+            return {};
+        }
+
+        // The accumulator is full, flush it as a whole word and keep whatever didn't fit
+        auto word = AK::convert_between_host_and_little_endian(m_accumulator);
+        __builtin_memcpy(m_bytes.data() + accumulator_index, &word, sizeof(word));
+
+        m_accumulator = free_bits < 64 ? value >> free_bits : 0;
+        m_accumulator_bits = number_of_bits - free_bits;
 
         return {};
     }
 
+    ErrorOr<void> write_bytes(ReadonlyBytes bytes) override
+    {
+        if (bytes.is_empty())
+            return {};
+
+        auto accumulator_index = (m_current_bit - m_accumulator_bits) >> 3;
+
+        // We check for room once here, everything below can write freely
+        auto required_size = accumulator_index + bytes.size() + (sizeof(m_accumulator) << 1);
+        if (required_size > m_bytes.size())
+            TRY(grow(required_size));
+
+        if ((m_accumulator_bits & 7) == 0)
+        {
+            // We're on a byte boundary, so write out what the accumulator has and copy the rest straight in
+            flush();
+            __builtin_memcpy(m_bytes.data() + (m_current_bit >> 3), bytes.data(), bytes.size());
+
+            m_current_bit += bytes.size() << 3;
+            m_accumulator = 0;
+            m_accumulator_bits = 0;
+
+            return {};
+        }
+
+        // Otherwise, shift each word into the accumulator and store a whole word each time. As many bits go in as come
+        // out, so m_accumulator_bits stays the same.
+        auto free_bits = 64 - m_accumulator_bits;
+
+        while (bytes.size() >= sizeof(u64))
+        {
+            u64 word;
+            __builtin_memcpy(&word, bytes.data(), sizeof(word));
+            word = AK::convert_between_host_and_little_endian(word);
+
+            auto accumulator_word =
+                AK::convert_between_host_and_little_endian(m_accumulator | (word << m_accumulator_bits));
+            __builtin_memcpy(m_bytes.data() + accumulator_index, &accumulator_word, sizeof(accumulator_word));
+
+            m_accumulator = word >> free_bits;
+            m_current_bit += 64;
+            accumulator_index += sizeof(u64);
+            bytes = bytes.slice(sizeof(u64));
+        }
+
+        u64 remaining = 0;
+        for (auto i = 0; i < bytes.size(); i++)
+            remaining |= static_cast<u64>(bytes[i]) << (i << 3);
+
+        return write_bits(remaining, bytes.size() << 3);
+    }
+
     ReadonlyBytes bytes() const
     {
+        flush();
+
         // FIXME: This calculation kinda sucks, any way we can do better?
         //        If we are on a byte boundary, we don't want an additional byte, but otherwise we need to include that
         //        last partial byte
@@ -272,6 +719,8 @@ public:
 
     Bytes bytes()
     {
+        flush();
+
         // FIXME: This calculation kinda sucks, any way we can do better?
         //        If we are on a byte boundary, we don't want an additional byte, but otherwise we need to include that
         //        last partial byte
@@ -282,6 +731,8 @@ public:
 
     ErrorOr<ByteBuffer> release_bytes()
     {
+        flush();
+
         // FIXME: This calculation kinda sucks, any way we can do better?
         //        If we are on a byte boundary, we don't want an additional byte, but otherwise we need to include that
         //        last partial byte
@@ -291,59 +742,248 @@ public:
         return move(m_bytes);
     }
 
+    // Unlike release_bytes, this leaves the buffer as large as it has grown to, so take bytes().size() first to know
+    // how much of it was written. Shrinking it could move it into ByteBuffer's inline storage and free its memory, and
+    // we want to write into it again without allocating (see DatagramBufferPool).
+    ByteBuffer release_buffer()
+    {
+        flush();
+        return move(m_bytes);
+    }
+
+    // Makes sure that number_of_bits can be written from the beginning without having to grow again. Useful when we
+    // already know how large something is going to be (see Message::size_in_bits).
+    ErrorOr<void> ensure_capacity(size_t number_of_bits)
+    {
+        auto required_size = ((number_of_bits + 7) >> 3) + (sizeof(m_accumulator) << 1);
+        if (required_size > m_bytes.size())
+            TRY(grow(required_size));
+
+        return {};
+    }
+
     ALWAYS_INLINE ErrorOr<size_t> position() const override { return m_current_bit; }
 
     ALWAYS_INLINE ErrorOr<void> set_position(size_t position) override
     {
+        flush();
+
         // FIXME: Should we just resize m_bytes to fit within this new position?
         if ((position >> 3) >= m_bytes.size())
             return Error::from_string_literal("Cannot set position out of bounds");
 
         m_current_bit = position;
+
+        // Start accumulating from the beginning of this byte, keeping the bits before us as they are
+        m_accumulator_bits = position & 7;
+        m_accumulator = m_bytes[position >> 3] & ((1 << m_accumulator_bits) - 1);
+
         return {};
     }
 
 private:
-    // Can't do a ErrorOr<T&>, have to use a pointer :^(
-    ALWAYS_INLINE ErrorOr<u8*> at(size_t index)
+    // Writes what the accumulator has back to m_bytes. This only touches the bits that were actually written, so that
+    // whatever comes after (like when patching a value in after the fact) is left alone.
+    ALWAYS_INLINE void flush() const
     {
-        if (index >= m_bytes.size())
-            TRY(m_bytes.try_resize(m_bytes.size() + amount_to_resize_each_allocation));
+        if (m_accumulator_bits == 0)
+            return;
+
+        auto accumulator_index = (m_current_bit - m_accumulator_bits) >> 3;
+        auto number_of_whole_bytes = m_accumulator_bits >> 3;
+        auto number_of_remaining_bits = m_accumulator_bits & 7;
 
-        return &m_bytes[index];
+        // write_bits has already made sure there is room for all of this
+        for (auto i = 0; i < number_of_whole_bytes; i++)
+            m_bytes.data()[accumulator_index + i] = static_cast<u8>(m_accumulator >> (i << 3));
+
+        if (number_of_remaining_bits > 0)
+        {
+            u8 mask = (1 << number_of_remaining_bits) - 1;
+            auto& last_byte = m_bytes.data()[accumulator_index + number_of_whole_bytes];
+            last_byte = (last_byte & ~mask) | (static_cast<u8>(m_accumulator >> (number_of_whole_bytes << 3)) & mask);
+        }
     }
 
-    static constexpr size_t amount_to_resize_each_allocation = 256;
-    ByteBuffer m_bytes;
+    // Grows geometrically, so that building a large packet doesn't reallocate over and over
+    ErrorOr<void> grow(size_t minimum_size)
+    {
+        auto old_size = m_bytes.size();
+        auto new_size = max(max(minimum_size, old_size << 1), minimum_allocation_size);
+
+        TRY(m_bytes.try_resize(new_size));
+        __builtin_memset(m_bytes.data() + old_size, 0, new_size - old_size);
+
+        return {};
+    }
+
+    static constexpr size_t minimum_allocation_size = 256;
+    // The accumulator is flushed lazily, even when our bytes are asked for through a const reference
+    mutable ByteBuffer m_bytes;
     size_t m_current_bit{};
+    // Holds the bits from the beginning of the byte that (m_current_bit - m_accumulator_bits) is in, up until
+    // m_current_bit. Only the lower m_accumulator_bits are valid, the rest are always zero.
+    u64 m_accumulator{};
+    u8 m_accumulator_bits{};
+};
+
+// Doesn't store anything, it only keeps track of how far we've written. Writing something into one of these tells us
+// exactly how many bits it will take, without having to put those bits anywhere.
+class CountingBitStream final : public WritableBitStream, public BitStreamWriter<CountingBitStream>
+{
+public:
+    using BitStreamWriter<CountingBitStream>::write_signed_varint;
+    using BitStreamWriter<CountingBitStream>::write_typed;
+    using BitStreamWriter<CountingBitStream>::write_varint;
+
+    ALWAYS_INLINE ErrorOr<void> write(bool) override
+    {
+        advance(1);
+        return {};
+    }
+
+    ALWAYS_INLINE ErrorOr<void> write_bits(u64, u8 number_of_bits) override
+    {
+        advance(number_of_bits);
+        return {};
+    }
+
+    ALWAYS_INLINE ErrorOr<void> write_bytes(ReadonlyBytes bytes) override
+    {
+        advance(bytes.size() << 3);
+        return {};
+    }
+
+    ALWAYS_INLINE ErrorOr<size_t> position() const override { return m_current_bit; }
+
+    ALWAYS_INLINE ErrorOr<void> set_position(size_t position) override
+    {
+        // Going back to patch something in is fine, but there's nothing to go forward to
+        if (position > m_size_in_bits)
+            return Error::from_string_literal("Cannot set position out of bounds");
+
+        m_current_bit = position;
+
+        return {};
+    }
+
+    size_t size_in_bits() const { return m_size_in_bits; }
+
+private:
+    ALWAYS_INLINE void advance(size_t number_of_bits)
+    {
+        m_current_bit += number_of_bits;
+        m_size_in_bits = max(m_size_in_bits, m_current_bit);
+    }
+
+    size_t m_current_bit{};
+    size_t m_size_in_bits{};
 };
-}
 
+// How many bits writing value is going to take. Anything with a fixed layout can say so with a constant_size_in_bits,
+// everything else is written into a CountingBitStream to find out. This is what TypedMessage, TypedUserMessage and
+// TypedConnectionlessPacket implement size_in_bits() with.
 template<typename T>
-ErrorOr<void> operator>>(SourceEngine::ReadableBitStream& stream, T& value) requires(IsIntegral<T>)
+ErrorOr<size_t> size_in_bits_of(const T& value)
+{
+    if constexpr (requires { T::constant_size_in_bits; })
+    {
+        return T::constant_size_in_bits;
+    }
+    else
+    {
+        CountingBitStream stream;
+        TRY(value.write(stream));
+        return stream.size_in_bits();
+    }
+}
+
+// Copies number_of_bits from source to destination as they are, without knowing anything about what they hold. This
+// is for when we want to pass something along (like a message we don't need to look into), without decoding it and
+// encoding it all over again. Any alignment works on either end.
+template<typename Source, typename Destination>
+ErrorOr<void> copy_bits(Source& source, Destination& destination, size_t number_of_bits) requires(
+    IsBaseOf<ReadableBitStream, Source> && IsBaseOf<WritableBitStream, Destination>)
+{
+    if constexpr (IsSame<Source, MemoryBitStream>)
+    {
+        // If the source is on a byte boundary, the bytes are already laid out in memory for us, and the destination
+        // can take them all at once.
+        if ((TRY(source.position()) & 7) == 0 && number_of_bits >= 8)
+        {
+            Bytes no_scratch;
+            auto bytes = TRY(source.read_bytes_view(number_of_bits >> 3, no_scratch));
+            TRY(destination.write_bytes(bytes));
+            number_of_bits &= 7;
+        }
+    }
+
+    // Otherwise, move a whole word at a time. The streams take care of their own alignment.
+    while (number_of_bits >= 64)
+    {
+        TRY(destination.write_bits(TRY(source.read_bits(64)), 64));
+        number_of_bits -= 64;
+    }
+
+    if (number_of_bits > 0)
+        TRY(destination.write_bits(TRY(source.read_bits(number_of_bits)), number_of_bits));
+
+    return {};
+}
+}
+
+// These are templated on the concrete stream, so that reading and writing through them stays statically dispatched.
+
+template<typename Stream, typename T>
+ErrorOr<void> operator>>(Stream& stream, T& value) requires(IsBaseOf<SourceEngine::ReadableBitStream, Stream> &&
+                                                            IsIntegral<T>)
 {
     value = TRY(stream.template read_typed<T>());
     return {};
 }
 
-template<typename T>
-ErrorOr<void> operator>>(SourceEngine::ReadableBitStream& stream, T& value) requires(IsSame<T, float>)
+template<typename Stream, typename T>
+ErrorOr<void> operator>>(Stream& stream, T& value) requires(IsBaseOf<SourceEngine::ReadableBitStream, Stream> &&
+                                                            IsSame<T, float>)
 {
     value = TRY(stream.template read_typed<T>());
     return {};
 }
 
-template<typename T>
-ErrorOr<void> operator<<(SourceEngine::WritableBitStream& stream, T value) requires(IsIntegral<T>)
+template<typename Stream, typename T>
+ErrorOr<void> operator<<(Stream& stream, T value) requires(IsBaseOf<SourceEngine::WritableBitStream, Stream> &&
+                                                           IsIntegral<T>)
 {
-    return stream.template write_typed(value);
+    return stream.write_typed(value);
 }
 
-template<typename T>
-ErrorOr<void> operator<<(SourceEngine::WritableBitStream& stream, T value) requires(IsSame<T, float>)
+template<typename Stream, typename T>
+ErrorOr<void> operator<<(Stream& stream, T value) requires(IsBaseOf<SourceEngine::WritableBitStream, Stream> &&
+                                                           IsSame<T, float>)
 {
-    return stream.template write_typed(value);
+    return stream.write_typed(value);
 }
 
-ErrorOr<void> operator>>(SourceEngine::ReadableBitStream& stream, String& value);
-ErrorOr<void> operator<<(SourceEngine::WritableBitStream& stream, StringView value);
\ No newline at end of file
+template<typename Stream>
+ErrorOr<void> operator>>(Stream& stream, String& value) requires(IsBaseOf<SourceEngine::ReadableBitStream, Stream>)
+{
+    // The Engine never reads strings anywhere near this long, so this is plenty for when a string can't be viewed where
+    // it is in the stream.
+    Array<u8, 4 * KiB> scratch;
+    Bytes scratch_bytes = scratch.span();
+
+    value = String(TRY(stream.read_string_view(scratch_bytes)));
+
+    return {};
+}
+
+template<typename Stream>
+ErrorOr<void> operator<<(Stream& stream, StringView value) requires(IsBaseOf<SourceEngine::WritableBitStream, Stream>)
+{
+    for (const char& c : value)
+        TRY(stream << c);
+
+    TRY(stream << '\0');
+
+    return {};
+}
\ No newline at end of file
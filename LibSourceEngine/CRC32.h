@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Array.h>
+#include <AK/Endian.h>
+#include <AK/Span.h>
+#include <AK/Types.h>
+
+namespace SourceEngine
+{
+// The same CRC32 as Crypto::Checksum::CRC32, which is what the Engine uses for packets and what VPK uses for its
+// entries. That goes through one byte at a time, this goes through 16 at a time with a table for each of them (known as
+// "slice-by-16"), as every packet we send and receive has to be checksummed.
+class CRC32
+{
+public:
+    CRC32() = default;
+    explicit CRC32(ReadonlyBytes bytes) { update(bytes); }
+
+    void update(ReadonlyBytes bytes)
+    {
+        auto state = m_state;
+        auto* data = bytes.data();
+        auto size = bytes.size();
+
+        while (size >= 16)
+        {
+            auto first = read_u32(data) ^ state;
+            auto second = read_u32(data + 4);
+            auto third = read_u32(data + 8);
+            auto fourth = read_u32(data + 12);
+
+            state = tables[15][first & 0xFF] ^ tables[14][(first >> 8) & 0xFF] ^ tables[13][(first >> 16) & 0xFF] ^
+                    tables[12][first >> 24] ^ tables[11][second & 0xFF] ^ tables[10][(second >> 8) & 0xFF] ^
+                    tables[9][(second >> 16) & 0xFF] ^ tables[8][second >> 24] ^ tables[7][third & 0xFF] ^
+                    tables[6][(third >> 8) & 0xFF] ^ tables[5][(third >> 16) & 0xFF] ^ tables[4][third >> 24] ^
+                    tables[3][fourth & 0xFF] ^ tables[2][(fourth >> 8) & 0xFF] ^ tables[1][(fourth >> 16) & 0xFF] ^
+                    tables[0][fourth >> 24];
+
+            data += 16;
+            size -= 16;
+        }
+
+        while (size-- > 0)
+            state = tables[0][(state ^ *data++) & 0xFF] ^ (state >> 8);
+
+        m_state = state;
+    }
+
+    u32 digest() const { return ~m_state; }
+
+private:
+    static constexpr u32 polynomial = 0xEDB88320;
+    static constexpr size_t number_of_tables = 16;
+
+    // The first table is the usual one for a single byte. Every table after it is for the byte before, which is the
+    // same as running the previous table's value through the first table one more time.
+    static constexpr auto tables = [] {
+        Array<Array<u32, 256>, number_of_tables> tables{};
+
+        for (u32 i = 0; i < 256; i++)
+        {
+            auto value = i;
+            for (auto bit = 0; bit < 8; bit++)
+                value = (value & 1) ? (value >> 1) ^ polynomial : value >> 1;
+
+            tables[0][i] = value;
+        }
+
+        for (size_t table = 1; table < number_of_tables; table++)
+        {
+            for (u32 i = 0; i < 256; i++)
+            {
+                auto previous = tables[table - 1][i];
+                tables[table][i] = (previous >> 8) ^ tables[0][previous & 0xFF];
+            }
+        }
+
+        return tables;
+    }();
+
+    static ALWAYS_INLINE u32 read_u32(const u8* data)
+    {
+        u32 value;
+        __builtin_memcpy(&value, data, sizeof(value));
+        return AK::convert_between_host_and_little_endian(value);
+    }
+
+    u32 m_state{~0u};
+};
+}
\ No newline at end of file
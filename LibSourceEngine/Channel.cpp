@@ -0,0 +1,420 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <LibSourceEngine/Channel.h>
+
+namespace SourceEngine
+{
+ErrorOr<bool> ReceivingChannel::read_fragments(MemoryBitStream& stream, Packet::Channel channel)
+{
+    auto start_fragment = TRY(stream.read_typed<u32>(Packet::max_file_size_bits - Packet::fragment_bits));
+    auto number_of_fragments = TRY(stream.read_typed<u32>(Packet::number_of_bits_for_fragment_count));
+
+    if (start_fragment == 0)
+    {
+        // The first fragment tells us about the whole thing
+        m_transfer_id.clear();
+        m_uncompressed_size.clear();
+
+        auto is_file = TRY(stream.read());
+        if (is_file)
+        {
+            m_transfer_id = TRY(stream.read_typed<u32>());
+            TRY(stream >> m_filename);
+        }
+
+        auto is_compressed = TRY(stream.read());
+        if (is_compressed)
+            m_uncompressed_size = TRY(stream.read_typed<u32>(Packet::max_file_size_bits));
+
+        TRY(begin(channel, TRY(stream.read_typed<u32>(Packet::max_file_size_bits)), m_uncompressed_size));
+    }
+    else if (!m_is_in_progress)
+    {
+        // We never got the first fragment (or we already have everything), the Engine will send these again if it
+        // needs to.
+        return false;
+    }
+
+    if (start_fragment + number_of_fragments > m_number_of_fragments)
+        return Error::from_string_literal("Fragments go past the end of the channel data");
+
+    auto offset = start_fragment << Packet::fragment_bits;
+    auto length = number_of_fragments << Packet::fragment_bits;
+
+    // The last fragment is only as large as whatever is left
+    if (start_fragment + number_of_fragments == m_number_of_fragments)
+        length = m_size_in_bytes - offset;
+
+    TRY(stream.read_bytes(m_bytes.bytes().slice(offset, length)));
+
+    for (auto fragment = start_fragment; fragment < start_fragment + number_of_fragments; fragment++)
+    {
+        auto& word = m_received_fragments[fragment >> 6];
+        auto bit = static_cast<u64>(1) << (fragment & 63);
+
+        if ((word & bit) == 0)
+        {
+            word |= bit;
+            ++m_number_of_received_fragments;
+        }
+    }
+
+    if (m_uncompressed_size.has_value())
+    {
+        // Decompress as much as we can now, rather than all of it at once when the last fragment arrives
+        while (m_number_of_decompressed_fragments < m_number_of_fragments &&
+               (m_received_fragments[m_number_of_decompressed_fragments >> 6] &
+                (static_cast<u64>(1) << (m_number_of_decompressed_fragments & 63))) != 0)
+        {
+            auto fragment_offset = m_number_of_decompressed_fragments << Packet::fragment_bits;
+            auto fragment_length = min(Packet::fragment_size, m_size_in_bytes - fragment_offset);
+            auto fragment = m_bytes.span().slice(fragment_offset, fragment_length);
+            TRY(m_decompressor.decompress(fragment, uncompressed_bytes()));
+            ++m_number_of_decompressed_fragments;
+        }
+
+        if (is_complete() && !m_decompressor.is_finished())
+            return Error::from_string_literal("Compressed channel data ended early");
+    }
+
+    return true;
+}
+
+ErrorOr<void> ReceivingChannel::read_compressed_block(MemoryBitStream& stream, Packet::Channel channel,
+                                                      u32 uncompressed_size)
+{
+    auto size_in_bytes = TRY(stream.read_varint());
+
+    m_transfer_id.clear();
+    m_uncompressed_size = uncompressed_size;
+    TRY(begin(channel, size_in_bytes, m_uncompressed_size));
+
+    // We only need to copy it if it isn't byte aligned in the packet
+    Bytes scratch = m_bytes.bytes();
+    auto compressed_bytes = TRY(stream.read_bytes_view(size_in_bytes, scratch));
+
+    TRY(m_decompressor.decompress(compressed_bytes, uncompressed_bytes()));
+    if (!m_decompressor.is_finished())
+        return Error::from_string_literal("Compressed channel data ended early");
+
+    m_is_in_progress = false;
+
+    return {};
+}
+
+ErrorOr<void> ReceivingChannel::begin(Packet::Channel channel, u32 size_in_bytes, Optional<u32> uncompressed_size)
+{
+    auto max_size_in_bytes = channel == Packet::Channel::File ? Packet::max_file_size : Packet::max_payload_size;
+    if (size_in_bytes > max_size_in_bytes || uncompressed_size.value_or(0) > max_size_in_bytes)
+        return Error::from_string_literal("Channel data is too large");
+
+    if (size_in_bytes > m_bytes.size())
+        TRY(m_bytes.try_resize(size_in_bytes));
+
+    if (uncompressed_size.has_value())
+    {
+        if (*uncompressed_size > m_uncompressed_bytes.size())
+            TRY(m_uncompressed_bytes.try_resize(*uncompressed_size));
+
+        m_decompressor.reset(*uncompressed_size);
+        m_number_of_decompressed_fragments = 0;
+    }
+
+    m_size_in_bytes = size_in_bytes;
+    m_number_of_fragments = (size_in_bytes + Packet::fragment_size - 1) >> Packet::fragment_bits;
+    m_number_of_received_fragments = 0;
+
+    auto number_of_words = (m_number_of_fragments + 63) >> 6;
+    if (number_of_words > m_received_fragments.size())
+        TRY(m_received_fragments.try_resize(number_of_words));
+
+    for (size_t i = 0; i < number_of_words; i++)
+        m_received_fragments[i] = 0;
+
+    m_is_in_progress = true;
+
+    return {};
+}
+
+ErrorOr<void> SendingChannel::enqueue(Packet::Channel channel, ByteBuffer&& data)
+{
+    auto max_size_in_bytes = channel == Packet::Channel::File ? Packet::max_file_size : Packet::max_payload_size;
+    if (data.size() > max_size_in_bytes)
+        return Error::from_string_literal("Channel data is too large");
+
+    // This would never be sent, and nothing else could be sent after it
+    if (data.is_empty())
+        return {};
+
+    if (data.size() >= min_size_to_compress)
+    {
+        auto compressed = TRY(ByteBuffer::create_uninitialized(data.size()));
+
+        LZSSCompressor compressor;
+        auto compressed_size = compressor.compress(data, compressed);
+
+        if (compressed_size.has_value())
+        {
+            compressed.resize(*compressed_size);
+            TRY(m_queue.try_append(Data{move(compressed), {}, static_cast<u32>(data.size()), {}}));
+
+            return {};
+        }
+    }
+
+    TRY(m_queue.try_append(Data{move(data), {}, {}, {}}));
+
+    return {};
+}
+
+ErrorOr<void> SendingChannel::enqueue_file(u32 transfer_id, String filename, ReadonlyBytes bytes)
+{
+    return enqueue_file(Data{{}, bytes, {}, File{transfer_id, move(filename)}});
+}
+
+ErrorOr<void> SendingChannel::enqueue_file(u32 transfer_id, String filename, ByteBuffer&& bytes)
+{
+    return enqueue_file(Data{move(bytes), {}, {}, File{transfer_id, move(filename)}});
+}
+
+ErrorOr<void> SendingChannel::enqueue_file(Data&& data)
+{
+    if (data.bytes().size() > Packet::max_file_size)
+        return Error::from_string_literal("File is too large");
+
+    // The Engine won't take a file with nothing in it either
+    if (data.bytes().is_empty())
+        return Error::from_string_literal("File is empty");
+
+    TRY(m_queue.try_append(move(data)));
+
+    return {};
+}
+
+bool SendingChannel::has_file(StringView filename) const
+{
+    for (auto& data : m_queue)
+    {
+        if (data.file.has_value() && data.file->filename.view() == filename)
+            return true;
+    }
+
+    return false;
+}
+
+size_t SendingChannel::number_of_files() const
+{
+    size_t number_of_files = 0;
+    for (auto& data : m_queue)
+    {
+        if (data.file.has_value())
+            number_of_files++;
+    }
+
+    return number_of_files;
+}
+
+ErrorOr<Subchannels::Acknowledgements> Subchannels::process_acknowledgements(u8 reliable_state, int sequence_ack)
+{
+    Acknowledgements acknowledgements;
+
+    for (size_t i = 0; i < number_of_subchannels; i++)
+    {
+        auto& subchannel = m_subchannels[i];
+        auto bit = 1 << i;
+
+        if (subchannel.state == State::Free)
+            continue;
+
+        if ((m_reliable_state & bit) == (reliable_state & bit))
+        {
+            if (subchannel.sequence > sequence_ack)
+                return Error::from_string_literal("Reliable state acknowledges something we haven't sent yet");
+
+            if (subchannel.state != State::Waiting)
+                continue;
+
+            for (size_t j = 0; j < Packet::number_of_channels; j++)
+            {
+                auto number_of_fragments = subchannel.number_of_fragments[j];
+                if (number_of_fragments == 0)
+                    continue;
+
+                auto& sending_channel = m_sending_channels[j];
+                sending_channel.m_number_of_acknowledged_fragments += number_of_fragments;
+                sending_channel.m_number_of_pending_fragments -= number_of_fragments;
+
+                if (sending_channel.m_number_of_acknowledged_fragments == sending_channel.number_of_fragments())
+                    sending_channel.dequeue();
+            }
+
+            subchannel = {};
+            acknowledgements.number_of_delivered_packets++;
+        }
+        else if (subchannel.state == State::Waiting && subchannel.sequence <= sequence_ack)
+        {
+            // They've seen the packet this was in, but didn't get this
+            subchannel.state = State::ToSend;
+            acknowledgements.number_of_lost_packets++;
+        }
+    }
+
+    return acknowledgements;
+}
+
+bool Subchannels::add_to_packet(SendingPacket& packet, int sequence, u32 max_number_of_fragments,
+                                u32 max_number_of_file_fragments)
+{
+    auto should_send = m_has_unsent_acknowledgement;
+
+    packet.set_reliable_state(m_received_reliable_state);
+    m_has_unsent_acknowledgement = false;
+
+    assign_fragments(max_number_of_fragments, max_number_of_file_fragments);
+
+    // Only one subchannel can be sent in each packet
+    for (size_t i = 0; i < number_of_subchannels; i++)
+    {
+        auto& subchannel = m_subchannels[i];
+        if (subchannel.state != State::ToSend)
+            continue;
+
+        packet.set_subchannel(i);
+        for (size_t j = 0; j < Packet::number_of_channels; j++)
+        {
+            if (subchannel.number_of_fragments[j] > 0)
+            {
+                packet.set_channel_fragments(static_cast<Packet::Channel>(j), m_sending_channels[j],
+                                             subchannel.start_fragment[j], subchannel.number_of_fragments[j]);
+            }
+        }
+
+        subchannel.state = State::Waiting;
+        subchannel.sequence = sequence;
+
+        return true;
+    }
+
+    return should_send;
+}
+
+bool Subchannels::has_unsent_data() const
+{
+    if (m_has_unsent_acknowledgement)
+        return true;
+
+    auto has_free_subchannel = false;
+    for (auto& subchannel : m_subchannels)
+    {
+        if (subchannel.state == State::ToSend)
+            return true;
+
+        has_free_subchannel |= subchannel.state == State::Free;
+    }
+
+    if (!has_free_subchannel)
+        return false;
+
+    for (size_t i = 0; i < Packet::number_of_channels; i++)
+    {
+        if (number_of_unassigned_fragments(static_cast<Packet::Channel>(i)) > 0)
+            return true;
+    }
+
+    return false;
+}
+
+u32 Subchannels::number_of_unassigned_fragments(Packet::Channel channel) const
+{
+    auto& sending_channel = m_sending_channels[static_cast<size_t>(channel)];
+    if (sending_channel.is_empty())
+        return 0;
+
+    if (channel == Packet::Channel::File)
+    {
+        size_t number_of_file_subchannels = 0;
+        for (auto& subchannel : m_subchannels)
+        {
+            if (subchannel.state != State::Free && subchannel.number_of_fragments[static_cast<size_t>(channel)] > 0)
+                number_of_file_subchannels++;
+        }
+
+        if (number_of_file_subchannels >= max_number_of_file_subchannels)
+            return 0;
+    }
+
+    auto number_of_sent_fragments =
+        sending_channel.m_number_of_acknowledged_fragments + sending_channel.m_number_of_pending_fragments;
+    return sending_channel.number_of_fragments() - number_of_sent_fragments;
+}
+
+void Subchannels::assign_fragments(u32 max_number_of_fragments, u32 max_number_of_file_fragments)
+{
+    Subchannel* free_subchannel{};
+    size_t free_subchannel_index{};
+    for (size_t i = 0; i < number_of_subchannels; i++)
+    {
+        if (m_subchannels[i].state == State::Free)
+        {
+            free_subchannel = &m_subchannels[i];
+            free_subchannel_index = i;
+            break;
+        }
+    }
+
+    // Everything is still on its way
+    if (!free_subchannel)
+        return;
+
+    max_number_of_fragments = min(max_number_of_fragments, Packet::max_fragments_per_packet);
+    auto number_of_fragments_left = max_number_of_fragments;
+    for (size_t i = 0; i < Packet::number_of_channels && number_of_fragments_left > 0; i++)
+    {
+        auto channel = static_cast<Packet::Channel>(i);
+        auto number_of_unassigned_fragments = this->number_of_unassigned_fragments(channel);
+        if (number_of_unassigned_fragments == 0)
+            continue;
+
+        auto& sending_channel = m_sending_channels[i];
+        auto number_of_sent_fragments = sending_channel.number_of_fragments() - number_of_unassigned_fragments;
+
+        auto room = number_of_fragments_left;
+        if (channel == Packet::Channel::File)
+            room = min(room, max(max_number_of_file_fragments, 1u));
+
+        if (number_of_sent_fragments == 0 && sending_channel.is_file())
+        {
+            auto number_of_fragments_for_file_information = sending_channel.number_of_fragments_for_file_information();
+            if (room > number_of_fragments_for_file_information)
+            {
+                room -= number_of_fragments_for_file_information;
+            }
+            else
+            {
+                // Wait for a packet with more room, unless this one would have nothing else in it anyway
+                if (number_of_fragments_left < max_number_of_fragments)
+                    continue;
+
+                room = 1;
+            }
+        }
+
+        auto number_of_fragments = min(room, number_of_unassigned_fragments);
+
+        free_subchannel->start_fragment[i] = number_of_sent_fragments;
+        free_subchannel->number_of_fragments[i] = number_of_fragments;
+        sending_channel.m_number_of_pending_fragments += number_of_fragments;
+        number_of_fragments_left -= min(number_of_fragments, number_of_fragments_left);
+    }
+
+    if (number_of_fragments_left == max_number_of_fragments)
+        return;
+
+    m_reliable_state ^= 1 << free_subchannel_index;
+    free_subchannel->state = State::ToSend;
+}
+}
\ No newline at end of file
@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Array.h>
+#include <AK/ByteBuffer.h>
+#include <AK/Error.h>
+#include <AK/Optional.h>
+#include <AK/String.h>
+#include <AK/Types.h>
+#include <AK/Vector.h>
+#include <LibSourceEngine/BitStream.h>
+#include <LibSourceEngine/LZSS.h>
+#include <LibSourceEngine/Packet.h>
+
+namespace SourceEngine
+{
+// Puts the data for one channel back together when it's been split up into fragments across multiple packets. Every
+// connection has one of these for each channel, which ReceivingPacket::read fills in as packets arrive.
+class ReceivingChannel
+{
+public:
+    // Reads the fragments for this channel out of a packet (everything after the is_fragmented bit). This returns false
+    // if we never got the first fragment, which means we don't know how large these are and can't read any further.
+    ErrorOr<bool> read_fragments(MemoryBitStream&, Packet::Channel);
+
+    // Single blocks don't need any of this unless they're compressed, in which case this reads and decompresses them
+    // (everything after the uncompressed size) so that they end up in bytes().
+    ErrorOr<void> read_compressed_block(MemoryBitStream&, Packet::Channel, u32 uncompressed_size);
+
+    // Throws away whatever was in progress. The Engine does this whenever a new transfer starts on the channel.
+    void reset() { m_is_in_progress = false; }
+
+    bool is_complete() const { return m_is_in_progress && m_number_of_received_fragments == m_number_of_fragments; }
+
+    // This is only valid until the next transfer starts, as the buffers are reused. Compressed data is decompressed as
+    // it arrives, so this is always uncompressed.
+    ReadonlyBytes bytes() const
+    {
+        if (m_uncompressed_size.has_value())
+            return m_uncompressed_bytes.span().trim(*m_uncompressed_size);
+
+        return m_bytes.span().trim(m_size_in_bytes);
+    }
+
+    Optional<u32> uncompressed_size() const { return m_uncompressed_size; }
+    Optional<u32> transfer_id() const { return m_transfer_id; }
+    const String& filename() const { return m_filename; }
+
+private:
+    ErrorOr<void> begin(Packet::Channel, u32 size_in_bytes, Optional<u32> uncompressed_size);
+    Bytes uncompressed_bytes() { return m_uncompressed_bytes.bytes().trim(*m_uncompressed_size); }
+
+    // Holds onto the largest transfer we've had so far, so that we aren't allocating for every transfer
+    ByteBuffer m_bytes;
+    ByteBuffer m_uncompressed_bytes;
+    LZSSDecompressor m_decompressor;
+    // Fragments can arrive in any order, but they have to be decompressed in order, so this is how many we've done
+    u32 m_number_of_decompressed_fragments{};
+    // One bit per fragment, set once it has arrived (they may arrive more than once, if the Engine resends them)
+    Vector<u64> m_received_fragments;
+    u32 m_size_in_bytes{};
+    u32 m_number_of_fragments{};
+    u32 m_number_of_received_fragments{};
+    bool m_is_in_progress{};
+    Optional<u32> m_uncompressed_size;
+    Optional<u32> m_transfer_id;
+    String m_filename;
+};
+
+// The sending side of ReceivingChannel. Data is queued up here, and then sent a few fragments at a time by
+// SendingPacket, until the other side has all of it.
+class SendingChannel
+{
+public:
+    friend class Subchannels;
+
+    // The Engine doesn't bother compressing anything smaller than this (net_compresspackets_minsize)
+    static constexpr size_t min_size_to_compress = 1024;
+
+    // This compresses the data if it's large enough, and only if that makes it smaller.
+    ErrorOr<void> enqueue(Packet::Channel, ByteBuffer&&);
+
+    // Files are sent as they are, without being compressed, so that they don't need to be copied. This one doesn't
+    // take ownership of the bytes, so they have to outlive the transfer (like the map, which lives as long as we do).
+    ErrorOr<void> enqueue_file(u32 transfer_id, String filename, ReadonlyBytes);
+    ErrorOr<void> enqueue_file(u32 transfer_id, String filename, ByteBuffer&&);
+
+    // Whether a file with this name is being sent, or waiting to be (the Engine's IsFileInWaitingList)
+    bool has_file(StringView filename) const;
+    size_t number_of_files() const;
+
+    // Everything below is about the data at the front of the queue, which is the only one being sent.
+    bool is_empty() const { return m_queue.is_empty(); }
+    void dequeue()
+    {
+        m_queue.take_first();
+        m_number_of_acknowledged_fragments = 0;
+        m_number_of_pending_fragments = 0;
+    }
+
+    u32 number_of_fragments() const
+    {
+        return (m_queue.first().bytes().size() + Packet::fragment_size - 1) >> Packet::fragment_bits;
+    }
+
+    bool is_file() const { return m_queue.first().file.has_value(); }
+
+    template<typename Stream>
+    ErrorOr<void> write_fragments(Stream& stream, u32 start_fragment, u32 number_of_fragments) const
+    {
+        auto data = m_queue.first().bytes();
+        auto uncompressed_size = m_queue.first().uncompressed_size;
+        auto& file = m_queue.first().file;
+        auto total_number_of_fragments = this->number_of_fragments();
+
+        if (number_of_fragments > Packet::max_fragments_per_packet ||
+            start_fragment + number_of_fragments > total_number_of_fragments)
+            return Error::from_string_literal("Cannot write fragments out of bounds");
+
+        // If it all fits, we can leave out the fragment information (but not for files, which need their name)
+        if (start_fragment == 0 && number_of_fragments == total_number_of_fragments && !file.has_value())
+        {
+            TRY(stream.write(false)); // Not fragmented
+            TRY(write_uncompressed_size(stream, uncompressed_size));
+            TRY(stream.write_varint(data.size()));
+            TRY(stream.write_bytes(data));
+
+            return {};
+        }
+
+        TRY(stream.write(true)); // Fragmented
+        TRY(stream.write_typed(start_fragment, Packet::max_file_size_bits - Packet::fragment_bits));
+        TRY(stream.write_typed(number_of_fragments, Packet::number_of_bits_for_fragment_count));
+
+        // The first fragment tells the other side about the whole thing
+        if (start_fragment == 0)
+        {
+            TRY(stream.write(file.has_value()));
+            if (file.has_value())
+            {
+                TRY(stream.write_typed(file->transfer_id));
+                TRY(stream << file->filename);
+            }
+
+            TRY(write_uncompressed_size(stream, uncompressed_size));
+            TRY(stream.write_typed(static_cast<u32>(data.size()), Packet::max_file_size_bits));
+        }
+
+        auto offset = static_cast<size_t>(start_fragment) << Packet::fragment_bits;
+        auto length = min(static_cast<size_t>(number_of_fragments) << Packet::fragment_bits, data.size() - offset);
+        TRY(stream.write_bytes(data.slice(offset, length)));
+
+        return {};
+    }
+
+private:
+    struct File
+    {
+        u32 transfer_id{};
+        String filename;
+    };
+
+    struct Data
+    {
+        // Only files can be borrowed, everything else we own
+        ReadonlyBytes bytes() const { return borrowed_bytes.is_empty() ? owned_bytes.bytes() : borrowed_bytes; }
+
+        ByteBuffer owned_bytes;
+        ReadonlyBytes borrowed_bytes;
+        // Only if it's compressed
+        Optional<u32> uncompressed_size;
+        Optional<File> file;
+    };
+
+    ErrorOr<void> enqueue_file(Data&&);
+
+    // The first fragment of a file also has its transfer ID and name, which take up room we'd give to fragments
+    u32 number_of_fragments_for_file_information() const
+    {
+        auto size = sizeof(u32) + m_queue.first().file->filename.length() + 1;
+        return (size + Packet::fragment_size - 1) >> Packet::fragment_bits;
+    }
+
+    template<typename Stream>
+    static ALWAYS_INLINE ErrorOr<void> write_uncompressed_size(Stream& stream, Optional<u32> uncompressed_size)
+    {
+        TRY(stream.write(uncompressed_size.has_value()));
+        if (uncompressed_size.has_value())
+            TRY(stream.write_typed(*uncompressed_size, Packet::max_file_size_bits));
+
+        return {};
+    }
+
+    Vector<Data> m_queue;
+    // Fragments of the data at the front of the queue that the other side has, and that are on their way there
+    u32 m_number_of_acknowledged_fragments{};
+    u32 m_number_of_pending_fragments{};
+};
+
+// Reliable data is sent on one of 8 subchannels. Each of them carries whatever fragments fit from the front of each
+// SendingChannel, and the other side acknowledges them by flipping the subchannel's bit in the reliable state it puts
+// in the header of its packets. If the other side has seen the packet we sent them in but hasn't flipped the bit, it
+// lost them, and they are sent again on the same subchannel.
+class Subchannels
+{
+public:
+    static constexpr size_t number_of_subchannels = 8;
+    // A file can only be on its way in this many subchannels at once, so that there's always one for anything else
+    static constexpr size_t max_number_of_file_subchannels = number_of_subchannels - 2;
+
+    SendingChannel& sending_channel(Packet::Channel channel)
+    {
+        return m_sending_channels[static_cast<size_t>(channel)];
+    }
+
+    // What an acknowledgement told us about the packets we've sent reliable data in
+    struct Acknowledgements
+    {
+        u32 number_of_delivered_packets{};
+        u32 number_of_lost_packets{};
+    };
+
+    // Call with the header of every packet we receive, once it's been read.
+    ErrorOr<Acknowledgements> process_acknowledgements(u8 reliable_state, int sequence_ack);
+
+    // Call once all the reliable data in a packet we received has been read (see ReceivingPacket::subchannel).
+    void acknowledge_received(u8 subchannel)
+    {
+        m_received_reliable_state ^= 1 << subchannel;
+        m_has_unsent_acknowledgement = true;
+    }
+
+    // Puts our acknowledgements and the next reliable data into a packet we're about to send with this sequence. The
+    // reliable data is either something the other side lost, or whatever comes next from the SendingChannels. Returns
+    // false if there's nothing that the other side needs from the packet. New data is limited to
+    // max_number_of_fragments, so that it fits in the packet, and the file channel only gets up to
+    // max_number_of_file_fragments of them, so that it can leave room for other things.
+    bool add_to_packet(SendingPacket&, int sequence, u32 max_number_of_fragments = Packet::max_fragments_per_packet,
+                       u32 max_number_of_file_fragments = Packet::max_fragments_per_packet);
+
+    // Whether add_to_packet would have anything to put in a packet right now
+    bool has_unsent_data() const;
+
+private:
+    enum class State
+    {
+        Free,
+        ToSend,
+        Waiting
+    };
+
+    struct Subchannel
+    {
+        State state{State::Free};
+        // The sequence of the packet this was last sent in
+        int sequence{-1};
+        Array<u32, Packet::number_of_channels> start_fragment{};
+        Array<u32, Packet::number_of_channels> number_of_fragments{};
+    };
+
+    // Gives the next fragments from the SendingChannels to a free subchannel, if there are any
+    void assign_fragments(u32 max_number_of_fragments, u32 max_number_of_file_fragments);
+
+    // How many fragments of a channel haven't been given to a subchannel yet, if it can be given any more right now
+    u32 number_of_unassigned_fragments(Packet::Channel) const;
+
+    Array<SendingChannel, Packet::number_of_channels> m_sending_channels;
+    Array<Subchannel, number_of_subchannels> m_subchannels;
+    // The bits we've flipped for what we've sent, and the bits we've flipped for what we've received
+    u8 m_reliable_state{};
+    u8 m_received_reliable_state{};
+    bool m_has_unsent_acknowledgement{};
+};
+}
\ No newline at end of file
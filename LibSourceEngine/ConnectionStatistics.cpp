@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/BuiltinWrappers.h>
+#include <LibSourceEngine/ConnectionStatistics.h>
+
+namespace SourceEngine
+{
+void ConnectionStatistics::sent(int sequence, Time now)
+{
+    m_sent_packets[static_cast<u32>(sequence) % window_size] = {sequence, now};
+}
+
+void ConnectionStatistics::received(const ReceivingPacket& packet, Time now)
+{
+    auto sequence = packet.sequence();
+    if (m_incoming_window.size > 0 && sequence <= m_latest_sequence)
+    {
+        received_out_of_order();
+        return;
+    }
+
+    if (m_incoming_window.size == 0)
+    {
+        m_incoming_window.packets = 1;
+        m_incoming_window.size = 1;
+    }
+    else
+    {
+        auto distance = static_cast<u64>(static_cast<i64>(sequence) - m_latest_sequence);
+        m_incoming_window.packets = distance >= window_size ? 0 : m_incoming_window.packets << distance;
+        m_incoming_window.packets |= 1;
+        m_incoming_window.size = min(m_incoming_window.size + distance, window_size);
+
+        // The sequences the other side used up choking packets weren't lost, they were never sent
+        auto number_of_choked_packets = min<u64>(packet.choked_number().value_or(0), distance - 1);
+        number_of_choked_packets = min<u64>(number_of_choked_packets, window_size - 1);
+        m_incoming_window.packets |= ((1ull << number_of_choked_packets) - 1) << 1;
+    }
+
+    m_latest_sequence = sequence;
+
+    auto sequence_ack = packet.sequence_ack();
+    if (sequence_ack <= m_latest_sequence_ack)
+        return;
+
+    m_latest_sequence_ack = sequence_ack;
+
+    // Only if we still remember sending it, and it's not an older packet that had the same place
+    auto& sent_packet = m_sent_packets[static_cast<u32>(sequence_ack) % window_size];
+    if (sent_packet.sequence == sequence_ack)
+        add_round_trip_time_sample((now - sent_packet.time).to_nanoseconds() / 1000000.0f);
+}
+
+void ConnectionStatistics::acknowledged(const Subchannels::Acknowledgements& acknowledgements)
+{
+    for (u32 i = 0; i < acknowledgements.number_of_delivered_packets + acknowledgements.number_of_lost_packets; i++)
+    {
+        m_outgoing_window.packets <<= 1;
+        m_outgoing_window.packets |= i < acknowledgements.number_of_delivered_packets ? 1 : 0;
+        m_outgoing_window.size = min(m_outgoing_window.size + 1, window_size);
+    }
+}
+
+float ConnectionStatistics::incoming_loss() const
+{
+    return m_incoming_window.loss();
+}
+
+float ConnectionStatistics::outgoing_loss() const
+{
+    return m_outgoing_window.loss();
+}
+
+float ConnectionStatistics::Window::loss() const
+{
+    if (size == 0)
+        return 0.0f;
+
+    // Anything before the window started is zero, as if it was lost, so only count what's in it
+    auto number_of_lost_packets = size - popcount(packets);
+    return static_cast<float>(number_of_lost_packets) / size;
+}
+
+void ConnectionStatistics::add_round_trip_time_sample(float milliseconds)
+{
+    if (!m_round_trip_time.has_value())
+    {
+        m_round_trip_time = milliseconds;
+        m_jitter = milliseconds / 2.0f;
+        return;
+    }
+
+    auto deviation = *m_round_trip_time - milliseconds;
+    if (deviation < 0.0f)
+        deviation = -deviation;
+
+    m_jitter += (deviation - m_jitter) / 4.0f;
+    *m_round_trip_time += (milliseconds - *m_round_trip_time) / 8.0f;
+}
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Array.h>
+#include <AK/Optional.h>
+#include <AK/Time.h>
+#include <AK/Types.h>
+#include <LibSourceEngine/Channel.h>
+#include <LibSourceEngine/Packet.h>
+
+namespace SourceEngine
+{
+// Latency and loss for a connection, worked out from the sequences in the packet headers. The Engine only acknowledges
+// the latest packet it got, not every one, so we can't tell which of our packets were lost from the headers alone.
+// Instead, outgoing loss comes from the packets with reliable data in them, as the other side does tell us about each
+// of those (see Subchannels::process_acknowledgements). Everything is kept over the last window_size packets, in fixed
+// windows, so keeping these up to date doesn't cost any more with a worse connection.
+class ConnectionStatistics
+{
+public:
+    // The same as how many packets the Engine keeps its own statistics over (NET_FRAMES_BACKUP)
+    static constexpr size_t window_size = 64;
+
+    // Call for every packet we send.
+    void sent(int sequence, Time now);
+
+    // Call for every packet we receive, once it's been read.
+    void received(const ReceivingPacket&, Time now);
+
+    // Call for packets we drop because we've already seen them (or anything after them).
+    void received_out_of_order() { m_number_of_out_of_order_packets++; }
+
+    void acknowledged(const Subchannels::Acknowledgements&);
+
+    // Smoothed like TCP does (RFC 6298), in milliseconds. This includes how long the other side waited before it sent
+    // its next packet, just like the Engine's own ping. Empty until a packet we remember sending is acknowledged.
+    Optional<float> round_trip_time() const { return m_round_trip_time; }
+
+    // How much the round trip time varies from one packet to the next, in milliseconds.
+    float jitter() const { return m_jitter; }
+
+    // These are between 0 and 1.
+    float incoming_loss() const;
+    float outgoing_loss() const;
+
+    u64 number_of_out_of_order_packets() const { return m_number_of_out_of_order_packets; }
+
+private:
+    struct SentPacket
+    {
+        int sequence{};
+        Time time;
+    };
+
+    // Each window is a bit for every packet, the lowest is the latest one, and whether it made it
+    struct Window
+    {
+        float loss() const;
+
+        u64 packets{};
+        size_t size{};
+    };
+
+    void add_round_trip_time_sample(float milliseconds);
+
+    Array<SentPacket, window_size> m_sent_packets;
+    int m_latest_sequence_ack{};
+    Optional<float> m_round_trip_time;
+    float m_jitter{};
+
+    Window m_incoming_window;
+    int m_latest_sequence{};
+    // We only know about outgoing loss in packets with reliable data, which this is a window over instead
+    Window m_outgoing_window;
+
+    u64 m_number_of_out_of_order_packets{};
+};
+}
\ No newline at end of file
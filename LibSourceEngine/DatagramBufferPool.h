@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/ByteBuffer.h>
+#include <AK/Error.h>
+#include <AK/Noncopyable.h>
+#include <AK/StdLibExtras.h>
+#include <AK/Types.h>
+#include <AK/Vector.h>
+
+namespace SourceEngine
+{
+// Hands out buffers of buffer_size bytes to receive or write datagrams into, and keeps them once they're given back, so
+// that the next datagram can use them. Once there are enough of them going around, nothing is allocated for datagrams.
+// The buffers give themselves back, so the pool has to outlive them.
+class DatagramBufferPool
+{
+    AK_MAKE_NONCOPYABLE(DatagramBufferPool);
+    AK_MAKE_NONMOVABLE(DatagramBufferPool);
+
+public:
+    static constexpr size_t default_buffer_size = 2 * KiB;
+    static constexpr size_t default_max_number_of_free_buffers = 64;
+
+    class Buffer
+    {
+        AK_MAKE_NONCOPYABLE(Buffer);
+
+    public:
+        friend DatagramBufferPool;
+
+        Buffer(Buffer&& other) : m_pool(exchange(other.m_pool, nullptr)), m_bytes(move(other.m_bytes)) {}
+        ~Buffer()
+        {
+            if (m_pool)
+                m_pool->give_back(move(m_bytes));
+        }
+
+        // This can be moved out and put back (like into an ExpandingBitStream, see release_buffer). If it isn't put
+        // back, or is shrunk (ByteBuffer frees its memory once it's small enough to be inline), the pool will have to
+        // allocate a new one instead, so keep track of how much of it is used separately.
+        ByteBuffer& byte_buffer() { return m_bytes; }
+        Bytes bytes() { return m_bytes.bytes(); }
+
+    private:
+        Buffer(DatagramBufferPool& pool, ByteBuffer&& bytes) : m_pool(&pool), m_bytes(move(bytes)) {}
+
+        DatagramBufferPool* m_pool{};
+        ByteBuffer m_bytes;
+    };
+
+    explicit DatagramBufferPool(size_t buffer_size = default_buffer_size,
+                                size_t max_number_of_free_buffers = default_max_number_of_free_buffers)
+        : m_buffer_size(buffer_size), m_max_number_of_free_buffers(max_number_of_free_buffers)
+    {
+        m_free_buffers.ensure_capacity(max_number_of_free_buffers);
+    }
+
+    size_t buffer_size() const { return m_buffer_size; }
+
+    ErrorOr<Buffer> take()
+    {
+        if (m_free_buffers.is_empty())
+            return Buffer(*this, TRY(ByteBuffer::create_uninitialized(m_buffer_size)));
+
+        return Buffer(*this, m_free_buffers.take_last());
+    }
+
+private:
+    void give_back(ByteBuffer&& bytes)
+    {
+        // Any more than this and we only hold on to memory for a burst that's over
+        if (bytes.capacity() < m_buffer_size || m_free_buffers.size() == m_max_number_of_free_buffers)
+            return;
+
+        // This is within its capacity, so it doesn't allocate
+        bytes.resize(m_buffer_size);
+        m_free_buffers.unchecked_append(move(bytes));
+    }
+
+    size_t m_buffer_size{};
+    size_t m_max_number_of_free_buffers{};
+    Vector<ByteBuffer> m_free_buffers;
+};
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/ByteBuffer.h>
+#include <AK/Error.h>
+#include <AK/NonnullRefPtr.h>
+#include <AK/RefCounted.h>
+#include <AK/RefPtr.h>
+#include <AK/Types.h>
+#include <LibSourceEngine/BitStream.h>
+#include <LibSourceEngine/Message.h>
+
+namespace SourceEngine
+{
+// A message that has already been written, for when the same message goes to many clients (like a Print to everyone).
+// It's only written once, and each copy of this shares those bits, which are copied into each client's packet as they
+// are (see copy_bits), at whatever bit they happen to land on.
+class EncodedMessage final : public Message
+{
+public:
+    static ErrorOr<EncodedMessage> encode(const Message& message)
+    {
+        auto size_in_bits = TRY(message.size_in_bits());
+
+        ExpandingBitStream stream;
+        TRY(stream.ensure_capacity(size_in_bits));
+        TRY(message.write(stream));
+
+        auto bytes = TRY(stream.release_bytes());
+        return EncodedMessage(TRY(try_make_ref_counted<Data>(message.id(), move(bytes), size_in_bits)));
+    }
+
+    u8 id() const override { return m_data->id; }
+
+    ErrorOr<void> write(WritableBitStream& stream) const override { return write_to(stream); }
+    ErrorOr<void> write(ExpandingBitStream& stream) const override { return write_to(stream); }
+
+    ErrorOr<size_t> size_in_bits() const override { return m_data->size_in_bits; }
+
+private:
+    struct Data : public RefCounted<Data>
+    {
+        Data(u8 id, ByteBuffer&& bytes, size_t size_in_bits) : id(id), bytes(move(bytes)), size_in_bits(size_in_bits)
+        {
+        }
+
+        u8 id{};
+        ByteBuffer bytes;
+        size_t size_in_bits{};
+    };
+
+    explicit EncodedMessage(NonnullRefPtr<Data> data) : m_data(move(data)) {}
+
+    template<typename Stream>
+    ErrorOr<void> write_to(Stream& stream) const
+    {
+        MemoryBitStream source(m_data->bytes.bytes());
+        TRY(copy_bits(source, stream, m_data->size_in_bits));
+        return {};
+    }
+
+    NonnullRefPtr<Data> m_data;
+};
+}
\ No newline at end of file
@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <LibSourceEngine/LZSS.h>
+
+namespace SourceEngine
+{
+static ALWAYS_INLINE void write_u32_little_endian(u8* destination, u32 value)
+{
+    destination[0] = value & 0xFF;
+    destination[1] = (value >> 8) & 0xFF;
+    destination[2] = (value >> 16) & 0xFF;
+    destination[3] = value >> 24;
+}
+
+static ALWAYS_INLINE u32 read_u32_little_endian(const u8* source)
+{
+    return source[0] | (source[1] << 8) | (source[2] << 16) | (static_cast<u32>(source[3]) << 24);
+}
+
+Optional<size_t> LZSSCompressor::compress(ReadonlyBytes input, Bytes output)
+{
+    VERIFY(output.size() >= input.size());
+
+    // The same as the Engine, this is too small to be worth it
+    if (input.size() <= LZSS::header_size + 8)
+        return {};
+
+    // Worst case, every token is a reference that starts a new group, and then we need room for the end as well
+    constexpr size_t max_token_size = 3;
+    auto output_limit = input.size() - max_token_size;
+
+    m_heads.fill(0);
+
+    auto hash = [&](size_t position) {
+        auto value = input[position] | (input[position + 1] << 8) | (input[position + 2] << 16);
+        return (value * 2654435761u) >> (32 - hash_bits);
+    };
+
+    auto insert = [&](size_t position) {
+        if (position + LZSS::min_match_length > input.size())
+            return;
+
+        auto& head = m_heads[hash(position)];
+        m_previous[position & (LZSS::window_size - 1)] = head;
+        head = position + 1;
+    };
+
+    write_u32_little_endian(output.data(), LZSS::signature);
+    write_u32_little_endian(output.data() + sizeof(u32), input.size());
+
+    size_t output_position = LZSS::header_size;
+    size_t commands_position = 0;
+    u32 command_bit = 8;
+
+    size_t position = 0;
+    while (position < input.size())
+    {
+        if (command_bit == 8)
+        {
+            commands_position = output_position++;
+            output[commands_position] = 0;
+            command_bit = 0;
+        }
+
+        auto length_to_match = min(input.size() - position, LZSS::max_match_length);
+        size_t best_length = 0;
+        size_t best_distance = 0;
+
+        if (length_to_match >= LZSS::min_match_length)
+        {
+            auto candidate = m_heads[hash(position)];
+            for (size_t i = 0; i < max_chain_length && candidate != 0; i++)
+            {
+                auto candidate_position = candidate - 1;
+                auto distance = position - candidate_position;
+                if (distance > LZSS::window_size)
+                    break;
+
+                size_t length = 0;
+                while (length < length_to_match && input[candidate_position + length] == input[position + length])
+                    length++;
+
+                if (length > best_length)
+                {
+                    best_length = length;
+                    best_distance = distance;
+
+                    if (length == length_to_match)
+                        break;
+                }
+
+                candidate = m_previous[candidate_position & (LZSS::window_size - 1)];
+            }
+        }
+
+        if (best_length >= LZSS::min_match_length)
+        {
+            auto encoded_distance = best_distance - 1;
+            output[commands_position] |= 1 << command_bit;
+            output[output_position++] = encoded_distance >> LZSS::length_bits;
+            output[output_position++] = ((encoded_distance << LZSS::length_bits) & 0xFF) | (best_length - 1);
+        }
+        else
+        {
+            best_length = 1;
+            output[output_position++] = input[position];
+        }
+
+        command_bit++;
+
+        for (size_t i = 0; i < best_length; i++)
+            insert(position++);
+
+        // Compressing this isn't saving us anything
+        if (output_position >= output_limit)
+            return {};
+    }
+
+    // The end is a reference that only copies one byte
+    if (command_bit == 8)
+    {
+        commands_position = output_position++;
+        output[commands_position] = 0;
+        command_bit = 0;
+    }
+
+    output[commands_position] |= 1 << command_bit;
+    output[output_position++] = 0;
+    output[output_position++] = 0;
+
+    return output_position;
+}
+
+void LZSSDecompressor::reset(size_t output_size)
+{
+    m_output_size = output_size;
+    m_output_position = 0;
+    m_header_position = 0;
+    m_commands = 1;
+    m_pending_reference.clear();
+    m_is_finished = false;
+}
+
+ErrorOr<void> LZSSDecompressor::decompress(ReadonlyBytes input, Bytes output)
+{
+    VERIFY(output.size() == m_output_size);
+
+    size_t position = 0;
+
+    if (m_header_position < LZSS::header_size)
+    {
+        auto length = min(input.size(), LZSS::header_size - m_header_position);
+        __builtin_memcpy(m_header.data() + m_header_position, input.data(), length);
+        m_header_position += length;
+        position += length;
+
+        if (m_header_position < LZSS::header_size)
+            return {};
+
+        if (read_u32_little_endian(m_header.data()) != LZSS::signature)
+            return Error::from_string_literal("LZSS data has an invalid signature");
+
+        if (read_u32_little_endian(m_header.data() + sizeof(u32)) != m_output_size)
+            return Error::from_string_literal("LZSS data is not the expected size");
+    }
+
+    // The Engine ignores anything after the end, so we will too
+    while (position < input.size() && !m_is_finished)
+    {
+        // If there's enough for a whole group, we don't need to keep checking if we've run out
+        constexpr size_t max_group_size = 1 + 8 * 2;
+        if (m_commands == 1 && !m_pending_reference.has_value())
+        {
+            while (input.size() - position >= max_group_size && !m_is_finished)
+            {
+                auto commands = input[position++];
+                for (auto i = 0; i < 8 && !m_is_finished; i++, commands >>= 1)
+                {
+                    if (commands & 1)
+                    {
+                        TRY(decompress_reference(output, input[position], input[position + 1]));
+                        position += 2;
+                    }
+                    else
+                    {
+                        TRY(decompress_literal(output, input[position++]));
+                    }
+                }
+            }
+
+            if (position == input.size() || m_is_finished)
+                break;
+
+            m_commands = input[position++] | 0x100;
+            continue;
+        }
+
+        if ((m_commands & 1) == 0)
+        {
+            TRY(decompress_literal(output, input[position++]));
+        }
+        else if (m_pending_reference.has_value())
+        {
+            TRY(decompress_reference(output, *m_pending_reference, input[position++]));
+            m_pending_reference.clear();
+        }
+        else if (position + 1 < input.size())
+        {
+            TRY(decompress_reference(output, input[position], input[position + 1]));
+            position += 2;
+        }
+        else
+        {
+            // The other half is in the next piece
+            m_pending_reference = input[position++];
+            continue;
+        }
+
+        m_commands >>= 1;
+    }
+
+    return {};
+}
+
+ErrorOr<void> LZSSDecompressor::decompress_literal(Bytes output, u8 value)
+{
+    if (m_output_position == m_output_size)
+        return Error::from_string_literal("LZSS data is larger than expected");
+
+    output[m_output_position++] = value;
+
+    return {};
+}
+
+ErrorOr<void> LZSSDecompressor::decompress_reference(Bytes output, u8 first, u8 second)
+{
+    auto distance = ((first << LZSS::length_bits) | (second >> LZSS::length_bits)) + 1;
+    auto length = (second & (LZSS::max_match_length - 1)) + 1;
+
+    if (length == 1)
+    {
+        if (m_output_position != m_output_size)
+            return Error::from_string_literal("LZSS data is smaller than expected");
+
+        m_is_finished = true;
+        return {};
+    }
+
+    if (distance > m_output_position)
+        return Error::from_string_literal("LZSS data refers to before the start");
+
+    if (length > m_output_size - m_output_position)
+        return Error::from_string_literal("LZSS data is larger than expected");
+
+    auto* destination = output.data() + m_output_position;
+    auto* source = destination - distance;
+
+    // These can overlap, which is how the Engine repeats a run of bytes
+    if (distance >= length)
+    {
+        __builtin_memcpy(destination, source, length);
+    }
+    else
+    {
+        for (size_t i = 0; i < length; i++)
+            destination[i] = source[i];
+    }
+
+    m_output_position += length;
+
+    return {};
+}
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Array.h>
+#include <AK/Error.h>
+#include <AK/Optional.h>
+#include <AK/Span.h>
+#include <AK/Types.h>
+
+namespace SourceEngine
+{
+// The LZSS the Engine uses to compress channel data. It starts with a header of "LZSS" and the size of the data once
+// it's uncompressed, then the data itself, in groups of up to 8 tokens. Each group starts with a command byte, with one
+// bit for each token (starting from the lowest), which says if that token is a literal byte (0) or a reference (1) to
+// something that came before. References are two bytes: 12 bits for how far back to go (minus one) and 4 bits for how
+// many bytes to copy (minus one). A reference that only copies one byte is the end of the data.
+struct LZSS
+{
+    static constexpr u32 signature = ('S' << 24) | ('S' << 16) | ('Z' << 8) | 'L';
+    static constexpr size_t header_size = sizeof(u32) + sizeof(u32);
+
+    static constexpr u32 distance_bits = 12;
+    static constexpr u32 length_bits = 4;
+    static constexpr size_t window_size = 1 << distance_bits;
+    static constexpr size_t min_match_length = 3;
+    static constexpr size_t max_match_length = 1 << length_bits;
+};
+
+// This doesn't find the same matches the Engine does (it only searches so far back, and hashes 3 bytes instead of one),
+// but the Engine doesn't care how the data was compressed, only that it decompresses.
+class LZSSCompressor
+{
+public:
+    // output needs to be at least as large as input. We give up as soon as we know that the compressed data won't be
+    // any smaller than input, so this only returns the size of the compressed data if it's worth using.
+    Optional<size_t> compress(ReadonlyBytes input, Bytes output);
+
+private:
+    static constexpr u32 hash_bits = 12;
+    static constexpr size_t max_chain_length = 32;
+
+    // Where we last saw each hash (plus one, so zero means we haven't), and where we saw it before that, for each
+    // position in the window
+    Array<u32, 1 << hash_bits> m_heads;
+    Array<u32, LZSS::window_size> m_previous;
+};
+
+// Decompresses into a buffer that has already been allocated, the data can be given to it in as many pieces as it
+// arrives in, in order.
+class LZSSDecompressor
+{
+public:
+    // The output has to be exactly as large as the data is once it's uncompressed, which we check against the header.
+    void reset(size_t output_size);
+
+    // This doesn't hold onto the output, so that it can be moved around between pieces (it's usually a ByteBuffer).
+    ErrorOr<void> decompress(ReadonlyBytes input, Bytes output);
+
+    bool is_finished() const { return m_is_finished; }
+
+private:
+    ALWAYS_INLINE ErrorOr<void> decompress_literal(Bytes output, u8);
+    ALWAYS_INLINE ErrorOr<void> decompress_reference(Bytes output, u8 first, u8 second);
+
+    size_t m_output_size{};
+    size_t m_output_position{};
+    Array<u8, LZSS::header_size> m_header;
+    size_t m_header_position{};
+    // The command byte we're working through, with a bit set above it so we know when we've run out (it's just 1)
+    u32 m_commands{1};
+    // A reference can be split between two pieces, this is the first half of it
+    Optional<u8> m_pending_reference;
+    bool m_is_finished{};
+};
+}
\ No newline at end of file
@@ -17,11 +17,41 @@ class Message
 public:
     static constexpr u32 number_of_bits_for_message_id = 6;
 
-    ALWAYS_INLINE virtual u8 id() const = 0;
+    virtual u8 id() const = 0;
 
-    ALWAYS_INLINE virtual ErrorOr<void> write(WritableBitStream& stream) const
+    // These are for when all we have is a Message&, like inside of SendingPacket. Every message implements a write
+    // templated on the concrete stream, and these just forward to it (see TypedMessage).
+    virtual ErrorOr<void> write(WritableBitStream&) const = 0;
+    virtual ErrorOr<void> write(ExpandingBitStream&) const = 0;
+
+    // How many bits write() is going to take, so that we can make room ahead of time. Messages with a fixed layout can
+    // say so with a constant_size_in_bits, everything else is written into a CountingBitStream to find out.
+    virtual ErrorOr<size_t> size_in_bits() const = 0;
+};
+
+template<typename T>
+class TypedMessage : public Message
+{
+public:
+    u8 id() const override { return T::constant_id; }
+
+    ErrorOr<void> write(WritableBitStream& stream) const override
+    {
+        return static_cast<const T&>(*this).write(stream);
+    }
+
+    ErrorOr<void> write(ExpandingBitStream& stream) const override
+    {
+        return static_cast<const T&>(*this).write(stream);
+    }
+
+    ErrorOr<size_t> size_in_bits() const override { return size_in_bits_of(static_cast<const T&>(*this)); }
+
+protected:
+    template<typename Stream>
+    ALWAYS_INLINE ErrorOr<void> write_id(Stream& stream) const
     {
-        TRY(stream.write_typed(id(), number_of_bits_for_message_id));
+        TRY(stream.write_typed(T::constant_id, number_of_bits_for_message_id));
         return {};
     }
 };
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Error.h>
+#include <AK/Noncopyable.h>
+#include <AK/OwnPtr.h>
+#include <AK/StdLibExtras.h>
+#include <AK/Types.h>
+#include <AK/Vector.h>
+#include <LibSourceEngine/Message.h>
+#include <new>
+
+namespace SourceEngine
+{
+// Owns messages of any type, so that they can be queued up from anywhere and written later (like at the end of a
+// tick). They're put one after another into blocks, and a block is kept around to be reused once every message in it
+// has been removed, so once a queue has had its busiest tick, queueing a message doesn't allocate at all. That holds
+// even if the queue never empties, like when some messages are always being held over to the next tick.
+class MessageQueue
+{
+    AK_MAKE_NONCOPYABLE(MessageQueue);
+
+public:
+    static constexpr size_t block_size = 4 * KiB;
+
+    MessageQueue() = default;
+    MessageQueue(MessageQueue&& other)
+        : m_entries(move(other.m_entries)), m_first_entry(exchange(other.m_first_entry, 0)),
+          m_blocks(move(other.m_blocks)), m_free_blocks(move(other.m_free_blocks)),
+          m_block_position(exchange(other.m_block_position, 0))
+    {
+    }
+
+    ~MessageQueue() { clear(); }
+
+    template<typename T>
+    requires(IsBaseOf<Message, T>) ErrorOr<void> enqueue(T message)
+    {
+        static_assert(sizeof(T) <= block_size, "Message is too large to be queued");
+        static_assert(alignof(T) <= block_alignment, "Message is aligned more than a block is");
+
+        // Make room first, so we never have a message that nothing is going to destroy
+        TRY(m_entries.try_ensure_capacity(m_entries.size() + 1));
+        auto* storage = TRY(allocate(sizeof(T), alignof(T)));
+
+        auto* queued_message = new (storage) T(move(message));
+        auto& block = *m_blocks.last();
+        block.number_of_messages++;
+        m_entries.unchecked_append(
+            Entry{queued_message, &block, [](Message& message) { static_cast<T&>(message).~T(); }});
+
+        return {};
+    }
+
+    bool is_empty() const { return size() == 0; }
+    size_t size() const { return m_entries.size() - m_first_entry; }
+
+    const Message& at(size_t index) const { return *m_entries[m_first_entry + index].message; }
+
+    ErrorOr<size_t> size_in_bits() const
+    {
+        size_t size_in_bits = 0;
+        for (size_t i = 0; i < size(); i++)
+            size_in_bits += TRY(at(i).size_in_bits());
+
+        return size_in_bits;
+    }
+
+    // Writes count messages starting from first, in the order they were queued
+    template<typename Stream>
+    ErrorOr<void> write(Stream& stream, size_t first, size_t count) const
+    {
+        VERIFY(first + count <= size());
+
+        for (size_t i = first; i < first + count; i++)
+            TRY(at(i).write(stream));
+
+        return {};
+    }
+
+    template<typename Stream>
+    ErrorOr<void> write(Stream& stream) const
+    {
+        return write(stream, 0, size());
+    }
+
+    void remove_first(size_t count)
+    {
+        VERIFY(count <= size());
+
+        for (size_t i = m_first_entry; i < m_first_entry + count; i++)
+            destroy(m_entries[i]);
+
+        m_first_entry += count;
+
+        if (m_first_entry == m_entries.size())
+        {
+            reset();
+            return;
+        }
+
+        // Messages are removed in the order they were queued, so the blocks that are empty now are at the front. The
+        // one we're allocating from stays, as there's still a message after these.
+        while (m_blocks.size() > 1 && m_blocks.first()->number_of_messages == 0)
+            m_free_blocks.unchecked_append(m_blocks.take_first());
+
+        // Once most of the entries are for removed messages, move what's left to the front, so they don't keep growing
+        if (m_first_entry > m_entries.size() / 2)
+        {
+            m_entries.remove(0, m_first_entry);
+            m_first_entry = 0;
+        }
+    }
+
+    void clear()
+    {
+        for (size_t i = m_first_entry; i < m_entries.size(); i++)
+            destroy(m_entries[i]);
+
+        reset();
+    }
+
+private:
+    static constexpr size_t block_alignment = 16;
+
+    struct Block
+    {
+        alignas(block_alignment) u8 data[block_size];
+        // How many of the messages in this haven't been removed yet
+        size_t number_of_messages{};
+    };
+
+    // Message doesn't have a virtual destructor, so we remember how to destroy each one when it's queued
+    struct Entry
+    {
+        Message* message{};
+        Block* block{};
+        void (*destroy)(Message&){};
+    };
+
+    static void destroy(Entry& entry)
+    {
+        entry.destroy(*entry.message);
+        entry.block->number_of_messages--;
+    }
+
+    void reset()
+    {
+        m_entries.clear_with_capacity();
+        m_first_entry = 0;
+        m_block_position = 0;
+
+        // Every block is empty now, so we go back to allocating from the first one
+        while (m_blocks.size() > 1)
+            m_free_blocks.unchecked_append(m_blocks.take_last());
+    }
+
+    // Always allocates from the last of m_blocks, starting a new block (a free one if we have one) when it's full
+    ErrorOr<void*> allocate(size_t size, size_t alignment)
+    {
+        if (!m_blocks.is_empty())
+        {
+            auto position = (m_block_position + alignment - 1) & ~(alignment - 1);
+            if (position + size <= block_size)
+            {
+                m_block_position = position + size;
+                return m_blocks.last()->data + position;
+            }
+        }
+
+        // Make room first, so that a block we take off the free list can't get lost, and so that the free list can hold
+        // every block once they're removed, without having to allocate then.
+        TRY(m_blocks.try_ensure_capacity(m_blocks.size() + 1));
+        if (m_free_blocks.is_empty())
+        {
+            TRY(m_free_blocks.try_ensure_capacity(m_blocks.size() + 1));
+            m_blocks.unchecked_append(TRY(try_make<Block>()));
+        }
+        else
+        {
+            m_blocks.unchecked_append(m_free_blocks.take_last());
+        }
+
+        m_block_position = size;
+
+        return m_blocks.last()->data;
+    }
+
+    Vector<Entry> m_entries;
+    // Everything before this has been removed
+    size_t m_first_entry{};
+    // These never move, even when the queue does, as the messages are in them. m_blocks holds the ones with messages in
+    // them, oldest first, and m_free_blocks the ones waiting to be used again.
+    Vector<NonnullOwnPtr<Block>> m_blocks;
+    Vector<NonnullOwnPtr<Block>> m_free_blocks;
+    size_t m_block_position{};
+};
+}
\ No newline at end of file
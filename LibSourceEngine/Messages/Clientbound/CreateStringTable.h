@@ -11,30 +11,30 @@
 
 namespace SourceEngine::Messages::Clientbound
 {
-class CreateStringTable final : public Message
+class CreateStringTable final : public TypedMessage<CreateStringTable>
 {
 public:
     static constexpr u8 constant_id = 12;
 
-    ALWAYS_INLINE u8 id() const override { return constant_id; }
-
-    static ErrorOr<CreateStringTable> read(ReadableBitStream& stream)
+    template<typename Stream>
+    static ErrorOr<CreateStringTable> read(Stream& stream)
     {
         // TODO: Implement CreateStringTable!
         return Error::from_string_literal("TODO: Implement CreateStringTable!");
     }
 
-    ALWAYS_INLINE ErrorOr<void> write(WritableBitStream& stream) const override
+    template<typename Stream>
+    ALWAYS_INLINE ErrorOr<void> write(Stream& stream) const
     {
-        TRY(Message::write(stream));
+        TRY(write_id(stream));
 
         // TODO: I think this needs to be a power of 2 for the log2 operation below to make sense... verify this!
         constexpr u16 max_entries = 1024;
 
         TRY(stream << m_name);
         // TODO: Implement this properly!
-        TRY(stream.write_typed<u16>(max_entries));
-        TRY(stream.write_typed<int>(0, AK::log2(max_entries) + 1));
+        TRY(stream.template write_typed<u16>(max_entries));
+        TRY(stream.template write_typed<int>(0, AK::log2(max_entries) + 1));
         TRY(stream.write_varint(0));
         TRY(stream.write(false));
         TRY(stream.write(false));
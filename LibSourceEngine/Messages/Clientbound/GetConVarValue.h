@@ -10,14 +10,13 @@
 
 namespace SourceEngine::Messages::Clientbound
 {
-class GetConVarValue final : public Message
+class GetConVarValue final : public TypedMessage<GetConVarValue>
 {
 public:
     static constexpr u8 constant_id = 31;
 
-    ALWAYS_INLINE u8 id() const override { return constant_id; }
-
-    static ErrorOr<GetConVarValue> read(ReadableBitStream& stream)
+    template<typename Stream>
+    static ErrorOr<GetConVarValue> read(Stream& stream)
     {
         GetConVarValue get_convar_value;
 
@@ -27,9 +26,10 @@ public:
         return get_convar_value;
     }
 
-    ALWAYS_INLINE ErrorOr<void> write(WritableBitStream& stream) const override
+    template<typename Stream>
+    ALWAYS_INLINE ErrorOr<void> write(Stream& stream) const
     {
-        TRY(Message::write(stream));
+        TRY(write_id(stream));
 
         TRY(stream << m_cookie);
         TRY(stream << m_convar_name);
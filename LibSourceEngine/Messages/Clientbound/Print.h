@@ -10,14 +10,13 @@
 
 namespace SourceEngine::Messages::Clientbound
 {
-class Print final : public Message
+class Print final : public TypedMessage<Print>
 {
 public:
     static constexpr u8 constant_id = 7;
 
-    ALWAYS_INLINE u8 id() const override { return constant_id; }
-
-    static ErrorOr<Print> read(ReadableBitStream& stream)
+    template<typename Stream>
+    static ErrorOr<Print> read(Stream& stream)
     {
         Print print;
 
@@ -26,9 +25,10 @@ public:
         return print;
     }
 
-    ALWAYS_INLINE ErrorOr<void> write(WritableBitStream& stream) const override
+    template<typename Stream>
+    ALWAYS_INLINE ErrorOr<void> write(Stream& stream) const
     {
-        TRY(Message::write(stream));
+        TRY(write_id(stream));
 
         auto message = m_automatically_append_newline_on_write ? String::formatted("{}\n", m_message) : m_message;
 
@@ -10,14 +10,13 @@
 
 namespace SourceEngine::Messages::Clientbound
 {
-class ServerInfo final : public Message
+class ServerInfo final : public TypedMessage<ServerInfo>
 {
 public:
     static constexpr u8 constant_id = 8;
 
-    ALWAYS_INLINE u8 id() const override { return constant_id; }
-
-    static ErrorOr<ServerInfo> read(ReadableBitStream& stream)
+    template<typename Stream>
+    static ErrorOr<ServerInfo> read(Stream& stream)
     {
         ServerInfo server_info;
 
@@ -25,7 +24,7 @@ public:
         TRY(stream >> server_info.m_server_count);
         server_info.m_is_hltv = TRY(stream.read());
         server_info.m_is_dedicated = TRY(stream.read());
-        TRY(stream.read_typed<i32>()); // client.dll CRC, used long ago before signed binaries, VAC, etc.
+        TRY(stream.template read_typed<i32>()); // client.dll CRC, used long ago before signed binaries, VAC, etc.
         TRY(stream >> server_info.m_max_classes);
         TRY(stream.read_bytes(server_info.m_map_md5.span()));
         TRY(stream >> server_info.m_player_slot);
@@ -42,15 +41,17 @@ public:
         return server_info;
     }
 
-    ALWAYS_INLINE ErrorOr<void> write(WritableBitStream& stream) const override
+    template<typename Stream>
+    ALWAYS_INLINE ErrorOr<void> write(Stream& stream) const
     {
-        TRY(Message::write(stream));
+        TRY(write_id(stream));
 
         TRY(stream << m_protocol);
         TRY(stream << m_server_count);
         TRY(stream.write(m_is_hltv));
         TRY(stream.write(m_is_dedicated));
-        TRY(stream.write_typed<i32>(1337420)); // client.dll CRC, used long ago before signed binaries, VAC, etc.
+        // client.dll CRC, used long ago before signed binaries, VAC, etc.
+        TRY(stream.template write_typed<i32>(1337420));
         TRY(stream << m_max_classes);
         TRY(stream.write_bytes(m_map_md5));
         TRY(stream << m_player_slot);
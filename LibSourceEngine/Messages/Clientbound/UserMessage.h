@@ -11,27 +11,25 @@
 
 namespace SourceEngine::Messages::Clientbound
 {
-class UserMessage final : public Message
+class UserMessage final : public TypedMessage<UserMessage>
 {
 public:
-    explicit UserMessage(SourceEngine::UserMessage& user_message) : m_user_message(user_message) {}
+    static constexpr u8 constant_id = 23;
 
-    ALWAYS_INLINE u8 id() const override { return 23; }
+    explicit UserMessage(SourceEngine::UserMessage& user_message) : m_user_message(user_message) {}
 
-    ALWAYS_INLINE ErrorOr<void> write(WritableBitStream& stream) const override
+    template<typename Stream>
+    ALWAYS_INLINE ErrorOr<void> write(Stream& stream) const
     {
-        TRY(Message::write(stream));
+        TRY(write_id(stream));
 
-        auto user_message_size_position = TRY(stream.position());
-        TRY(stream.write_typed(0, number_of_bits_for_user_message_size));
-        TRY(m_user_message.write(stream));
-        auto user_message_after_write_position = TRY(stream.position());
+        // The size goes before the data, so we find it out up front rather than coming back to patch it in
+        auto user_message_size = TRY(m_user_message.size_in_bits());
+        if (user_message_size >= (1 << number_of_bits_for_user_message_size))
+            return Error::from_string_literal("User message is too large");
 
-        TRY(stream.set_position(user_message_size_position));
-        // Need to subtract number_of_bits_for_user_message_size as that's not included in the size of the data
-        TRY(stream.write_typed(user_message_after_write_position - user_message_size_position -
-                               number_of_bits_for_user_message_size));
-        TRY(stream.set_position(user_message_after_write_position));
+        TRY(stream.write_typed(user_message_size, number_of_bits_for_user_message_size));
+        TRY(m_user_message.write(stream));
 
         return {};
     }
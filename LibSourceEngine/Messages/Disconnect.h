@@ -13,23 +13,23 @@
 
 namespace SourceEngine::Messages
 {
-class Disconnect final : public Message
+class Disconnect final : public TypedMessage<Disconnect>
 {
 public:
     static constexpr u8 constant_id = 1;
 
-    ALWAYS_INLINE u8 id() const override { return constant_id; }
-
-    ALWAYS_INLINE ErrorOr<void> write(WritableBitStream& stream) const override
+    template<typename Stream>
+    ALWAYS_INLINE ErrorOr<void> write(Stream& stream) const
     {
-        TRY(Message::write(stream));
+        TRY(write_id(stream));
 
         TRY(stream << m_reason);
 
         return {};
     }
 
-    static ErrorOr<Disconnect> read(ReadableBitStream& stream)
+    template<typename Stream>
+    static ErrorOr<Disconnect> read(Stream& stream)
     {
         Disconnect disconnect;
 
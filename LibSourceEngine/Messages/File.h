@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/String.h>
+#include <LibSourceEngine/Message.h>
+
+namespace SourceEngine::Messages
+{
+// Clients send this to ask for a file they're missing (like the map), which is sent back on the file channel with the
+// same transfer ID. If we won't send it, we tell them by sending this back with is_requested set to false.
+class File final : public TypedMessage<File>
+{
+public:
+    static constexpr u8 constant_id = 2;
+
+    template<typename Stream>
+    ALWAYS_INLINE ErrorOr<void> write(Stream& stream) const
+    {
+        TRY(write_id(stream));
+
+        TRY(stream << m_transfer_id);
+        TRY(stream << m_filename);
+        TRY(stream.write(m_is_requested));
+
+        return {};
+    }
+
+    template<typename Stream>
+    static ErrorOr<File> read(Stream& stream)
+    {
+        File file;
+
+        TRY(stream >> file.m_transfer_id);
+        TRY(stream >> file.m_filename);
+        file.m_is_requested = TRY(stream.read());
+
+        return file;
+    }
+
+    u32 transfer_id() const { return m_transfer_id; }
+    void set_transfer_id(u32 value) { m_transfer_id = value; }
+    const String& filename() const { return m_filename; }
+    void set_filename(String value) { m_filename = move(value); }
+    bool is_requested() const { return m_is_requested; }
+    void set_is_requested(bool value) { m_is_requested = value; }
+
+private:
+    u32 m_transfer_id{};
+    String m_filename;
+    bool m_is_requested{};
+};
+}
\ No newline at end of file
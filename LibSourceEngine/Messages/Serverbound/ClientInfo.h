@@ -11,14 +11,15 @@
 
 namespace SourceEngine::Messages::Serverbound
 {
-class ClientInfo final : public Message
+class ClientInfo final : public TypedMessage<ClientInfo>
 {
 public:
-    ALWAYS_INLINE u8 id() const override { return 8; }
+    static constexpr u8 constant_id = 8;
 
-    ALWAYS_INLINE ErrorOr<void> write(WritableBitStream& stream) const override
+    template<typename Stream>
+    ALWAYS_INLINE ErrorOr<void> write(Stream& stream) const
     {
-        TRY(Message::write(stream));
+        TRY(write_id(stream));
 
         TRY(stream << m_server_count);
         TRY(stream << m_send_table_crc);
@@ -45,7 +46,8 @@ public:
         return {};
     }
 
-    static ErrorOr<ClientInfo> read(ReadableBitStream& stream)
+    template<typename Stream>
+    static ErrorOr<ClientInfo> read(Stream& stream)
     {
         ClientInfo info;
 
@@ -60,7 +62,7 @@ public:
         {
             if (TRY(stream.read()))
             {
-                auto crc = TRY(stream.read_typed<u32>());
+                auto crc = TRY(stream.template read_typed<u32>());
                 custom_file_crc = crc;
             }
         }
@@ -11,7 +11,7 @@
 
 namespace SourceEngine::Messages::Serverbound
 {
-class RespondConVarValue final : public Message
+class RespondConVarValue final : public TypedMessage<RespondConVarValue>
 {
 public:
     enum class Response : u8
@@ -24,11 +24,10 @@ public:
 
     static constexpr u8 constant_id = 13;
 
-    ALWAYS_INLINE u8 id() const override { return constant_id; }
-
-    ALWAYS_INLINE ErrorOr<void> write(WritableBitStream& stream) const override
+    template<typename Stream>
+    ALWAYS_INLINE ErrorOr<void> write(Stream& stream) const
     {
-        TRY(Message::write(stream));
+        TRY(write_id(stream));
 
         TRY(stream << m_cookie);
         TRY(stream.write_typed(static_cast<u8>(m_response), 4));
@@ -38,12 +37,13 @@ public:
         return {};
     }
 
-    static ErrorOr<RespondConVarValue> read(ReadableBitStream& stream)
+    template<typename Stream>
+    static ErrorOr<RespondConVarValue> read(Stream& stream)
     {
         RespondConVarValue info;
 
         TRY(stream >> info.m_cookie);
-        auto response = TRY(stream.read_typed<u8>(4));
+        auto response = TRY(stream.template read_typed<u8>(4));
         info.m_response = static_cast<Response>(response);
         TRY(stream >> info.m_convar_name);
         TRY(stream >> info.m_convar_value);
@@ -6,27 +6,27 @@
 
 #pragma once
 
+#include <AK/Array.h>
 #include <AK/HashMap.h>
 #include <AK/String.h>
 #include <LibSourceEngine/Message.h>
 
 namespace SourceEngine::Messages
 {
-class SetConVar final : public Message
+class SetConVar final : public TypedMessage<SetConVar>
 {
 public:
     static constexpr u8 constant_id = 5;
 
-    ALWAYS_INLINE u8 id() const override { return constant_id; }
-
-    ALWAYS_INLINE ErrorOr<void> write(WritableBitStream& stream) const override
+    template<typename Stream>
+    ALWAYS_INLINE ErrorOr<void> write(Stream& stream) const
     {
-        TRY(Message::write(stream));
+        TRY(write_id(stream));
 
         if (m_convars.size() >= NumericLimits<u8>::max())
             return Error::from_string_literal("Too many convars in SetConVar message");
 
-        TRY(stream.write_typed<u8>(m_convars.size()));
+        TRY(stream.template write_typed<u8>(m_convars.size()));
 
         for (auto& kv : m_convars)
         {
@@ -37,24 +37,39 @@ public:
         return {};
     }
 
-    static ErrorOr<SetConVar> read(ReadableBitStream& stream)
+    template<typename Stream>
+    static ErrorOr<SetConVar> read(Stream& stream)
     {
         SetConVar set_con_var;
 
-        auto size = TRY(stream.read_typed<u8>());
-        TRY(set_con_var.m_convars.try_ensure_capacity(size));
+        // The Engine never sends names or values anywhere near this long
+        Array<u8, 4 * KiB> scratch;
+
+        TRY(read_each(stream, scratch.span(), [&](StringView key, StringView value) -> ErrorOr<void> {
+            set_con_var.m_convars.set(String(key), String(value));
+            return {};
+        }));
+
+        return set_con_var;
+    }
+
+    // Reads every convar without allocating anything, calling callback with the name and value of each. These views
+    // point either into the stream or scratch, so they are only valid until the callback returns.
+    template<typename Stream, typename Callback>
+    static ErrorOr<void> read_each(Stream& stream, Bytes scratch, Callback callback)
+    {
+        auto size = TRY(stream.template read_typed<u8>());
 
         for (auto i = 0; i < size; i++)
         {
-            String key;
-            String value;
-            TRY(stream >> key);
-            TRY(stream >> value);
+            auto remaining_scratch = scratch;
+            auto key = TRY(stream.read_string_view(remaining_scratch));
+            auto value = TRY(stream.read_string_view(remaining_scratch));
 
-            set_con_var.m_convars.set(move(key), move(value));
+            TRY(callback(key, value));
         }
 
-        return set_con_var;
+        return {};
     }
 
     const HashMap<String, String>& convars() const { return m_convars; }
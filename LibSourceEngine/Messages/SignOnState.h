@@ -13,16 +13,16 @@
 
 namespace SourceEngine::Messages
 {
-class SignOnState final : public Message
+class SignOnState final : public TypedMessage<SignOnState>
 {
 public:
     static constexpr u8 constant_id = 6;
+    static constexpr size_t constant_size_in_bits = number_of_bits_for_message_id + ((sizeof(u8) + sizeof(int)) << 3);
 
-    ALWAYS_INLINE u8 id() const override { return constant_id; }
-
-    ALWAYS_INLINE ErrorOr<void> write(WritableBitStream& stream) const override
+    template<typename Stream>
+    ALWAYS_INLINE ErrorOr<void> write(Stream& stream) const
     {
-        TRY(Message::write(stream));
+        TRY(write_id(stream));
 
         TRY(stream.write_typed(static_cast<u8>(m_sign_on_state)));
         TRY(stream.write_typed(m_spawn_count));
@@ -30,11 +30,12 @@ public:
         return {};
     }
 
-    static ErrorOr<SignOnState> read(ReadableBitStream& stream)
+    template<typename Stream>
+    static ErrorOr<SignOnState> read(Stream& stream)
     {
         SignOnState sign_on_state_message;
 
-        auto sign_on_state = TRY(stream.read_typed<u8>());
+        auto sign_on_state = TRY(stream.template read_typed<u8>());
         sign_on_state_message.m_sign_on_state = static_cast<SourceEngine::SignOnState>(sign_on_state);
         TRY(stream >> sign_on_state_message.m_spawn_count);
 
@@ -7,22 +7,34 @@
 #pragma once
 
 #include <AK/HashMap.h>
+#include <AK/NumericLimits.h>
+#include <AK/StdLibExtras.h>
 #include <AK/String.h>
 #include <LibSourceEngine/Message.h>
 #include <LibSourceEngine/SignOnState.h>
 
 namespace SourceEngine::Messages
 {
-class Tick final : public Message
+class Tick final : public TypedMessage<Tick>
 {
 public:
     static constexpr u8 constant_id = 3;
+    static constexpr size_t constant_size_in_bits =
+        number_of_bits_for_message_id + ((sizeof(int) + sizeof(u16) + sizeof(u16)) << 3);
 
-    ALWAYS_INLINE u8 id() const override { return constant_id; }
+    // The Engine's NET_TICK_SCALEUP, the frame times are sent in units of 1/100000 of a second
+    static constexpr float frame_time_scale = 100000.0f;
 
-    ALWAYS_INLINE ErrorOr<void> write(WritableBitStream& stream) const override
+    // Converts a frame time in seconds to what goes in the message, which is at most about 0.65 seconds
+    static u16 frame_time_from_seconds(float seconds)
     {
-        TRY(Message::write(stream));
+        return static_cast<u16>(clamp(seconds * frame_time_scale, 0.0f, static_cast<float>(NumericLimits<u16>::max())));
+    }
+
+    template<typename Stream>
+    ALWAYS_INLINE ErrorOr<void> write(Stream& stream) const
+    {
+        TRY(write_id(stream));
 
         TRY(stream << m_tick);
         // FIXME: Host frame time and host frame time standard deviation is only included with protocol version > 10...
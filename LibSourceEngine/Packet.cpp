@@ -4,13 +4,17 @@
  * SPDX-License-Identifier: GPL-3.0-only
  */
 
-#include <LibCrypto/Checksum/CRC32.h>
+#include <LibSourceEngine/CRC32.h>
+#include <LibSourceEngine/Channel.h>
 #include <LibSourceEngine/Packet.h>
 
 namespace SourceEngine
 {
-ErrorOr<ReceivingPacket> ReceivingPacket::read(MemoryBitStream& stream)
+ErrorOr<ReceivingPacket> ReceivingPacket::read(MemoryBitStream& stream, Span<ReceivingChannel> channels,
+                                               Checksum checksum)
 {
+    VERIFY(channels.size() == Packet::number_of_channels);
+
     ReceivingPacket packet;
 
     TRY(stream >> packet.m_sequence);
@@ -21,13 +25,8 @@ ErrorOr<ReceivingPacket> ReceivingPacket::read(MemoryBitStream& stream)
     auto flags = static_cast<Packet::Flags>(TRY(stream.read_typed<u8>()));
     TRY(stream >> packet.m_checksum);
 
-    auto bytes_to_checksum = stream.readonly_bytes().slice(TRY(stream.position()) >> 3);
-
-    auto our_calculated_checksum = Crypto::Checksum::CRC32(bytes_to_checksum).digest();
-    auto our_calculated_checksum_compressed = Packet::compress_checksum_to_u16(our_calculated_checksum);
-
-    if (our_calculated_checksum_compressed != packet.m_checksum)
-        return Error::from_string_literal("Checksum does not match data");
+    if (checksum == Checksum::Verify)
+        TRY(verify_checksum(packet.m_checksum, stream.readonly_bytes().slice(TRY(stream.position()) >> 3)));
 
     TRY(stream >> packet.m_reliable_state);
 
@@ -47,56 +46,128 @@ ErrorOr<ReceivingPacket> ReceivingPacket::read(MemoryBitStream& stream)
     {
         auto subchannel = TRY(stream.read_typed<u8>(3));
 
-        for (auto i = 0; i < static_cast<size_t>(Packet::Channel::__Count); i++)
+        for (auto i = 0; i < Packet::number_of_channels; i++)
         {
             // This channel has data
             if (TRY(stream.read()))
-                TRY(read_channel(static_cast<Packet::Channel>(i), subchannel, stream, packet));
+            {
+                // Whatever comes after can't be read, so we'll just have to wait for the Engine to send it again
+                if (!TRY(read_channel(static_cast<Packet::Channel>(i), subchannel, stream, channels[i], packet)))
+                    return packet;
+            }
         }
+
+        packet.m_subchannel = subchannel;
     }
 
-    // FIXME: This calculation kinda sucks, any way we can do better?
-    //        If we are on a byte boundary, we don't want an additional byte, but otherwise we need to include that
-    //        last partial byte
+    // Everything else, up until the end of the packet
     auto unreliable_data_position = TRY(stream.position());
-    auto remaining_length_in_bytes = stream.readonly_bytes().size() -
-                                     ((unreliable_data_position >> 3) + (unreliable_data_position % 8 == 0 ? 0 : 1));
-    packet.m_unreliable_data = TRY(stream.read_bytes(remaining_length_in_bytes));
+    packet.m_unreliable_data =
+        BitSpan(stream.readonly_bytes(), unreliable_data_position, stream.size_in_bits() - unreliable_data_position);
 
     return packet;
 }
 
-ErrorOr<void> ReceivingPacket::read_channel(Packet::Channel channel, u8 subchannel, MemoryBitStream& stream,
-                                            ReceivingPacket& packet)
+ErrorOr<void> ReceivingPacket::verify_checksum(ReadonlyBytes datagram)
+{
+    if (datagram.size() < checksummed_data_offset)
+        return Error::from_string_literal("Not enough bytes for a packet header");
+
+    MemoryBitStream stream(datagram);
+    TRY(stream.skip((checksummed_data_offset - sizeof(u16)) << 3));
+    auto checksum = TRY(stream.read_typed<u16>());
+
+    return verify_checksum(checksum, datagram.slice(checksummed_data_offset));
+}
+
+ErrorOr<void> ReceivingPacket::verify_checksum(u16 checksum, ReadonlyBytes bytes_to_checksum)
+{
+    auto our_calculated_checksum = CRC32(bytes_to_checksum).digest();
+    auto our_calculated_checksum_compressed = Packet::compress_checksum_to_u16(our_calculated_checksum);
+
+    if (our_calculated_checksum_compressed != checksum)
+        return Error::from_string_literal("Checksum does not match data");
+
+    return {};
+}
+
+ErrorOr<bool> ReceivingPacket::read_channel(Packet::Channel channel, u8 subchannel, MemoryBitStream& stream,
+                                            ReceivingChannel& receiving_channel, ReceivingPacket& packet)
 {
     // Engine calls this "is_single_block", where I assume a "block" means a fragment (like they use everywhere else...)
     // I'm going to rename this to a much more fitting name, but it also makes the meaning in the Engine inverse.
     auto is_fragmented = TRY(stream.read());
 
-    // FIXME: Know how to deal with fragmented channel data
     if (is_fragmented)
-        return Error::from_string_literal("Don't know how to deal with fragmented channel data");
+    {
+        if (!TRY(receiving_channel.read_fragments(stream, channel)))
+            return false;
+
+        if (!receiving_channel.is_complete())
+            return true;
+
+        auto bytes = receiving_channel.bytes();
+        ChannelData channel_data(BitSpan(bytes, 0, bytes.size() << 3));
+        channel_data.m_subchannel = subchannel;
+
+        packet.m_channel_data[static_cast<size_t>(channel)] = channel_data;
+
+        // We're done with it, but the bytes stay where they are until the next transfer starts
+        receiving_channel.reset();
+
+        return true;
+    }
+
+    // This is a whole new transfer, so whatever was in progress isn't coming
+    receiving_channel.reset();
 
     auto compressed = TRY(stream.read());
 
-    // FIXME: Know how to deal with compressed channel data
     if (compressed)
-        return Error::from_string_literal("Don't know how to deal with compressed channel data");
+    {
+        // This has to be decompressed somewhere, so it goes through the channel like fragmented data does
+        auto uncompressed_size = TRY(stream.read_typed<u32>(Packet::max_file_size_bits));
+        TRY(receiving_channel.read_compressed_block(stream, channel, uncompressed_size));
+
+        auto bytes = receiving_channel.bytes();
+        ChannelData channel_data(BitSpan(bytes, 0, bytes.size() << 3));
+        channel_data.m_subchannel = subchannel;
+
+        packet.m_channel_data[static_cast<size_t>(channel)] = channel_data;
+
+        return true;
+    }
 
     auto data_size_in_bytes = TRY(stream.read_varint());
 
-    auto data_buffer = TRY(stream.read_bytes(data_size_in_bytes));
-    ChannelData channel_data(move(data_buffer));
+    auto data_position = TRY(stream.position());
+    auto data_size_in_bits = static_cast<size_t>(data_size_in_bytes) << 3;
+    TRY(stream.skip(data_size_in_bits));
+
+    ChannelData channel_data(BitSpan(stream.readonly_bytes(), data_position, data_size_in_bits));
     channel_data.m_subchannel = subchannel;
 
-    packet.m_channel_data.set(channel, move(channel_data));
+    packet.m_channel_data[static_cast<size_t>(channel)] = channel_data;
 
-    return {};
+    return true;
 }
 
 ErrorOr<ByteBuffer> SendingPacket::write() const
 {
-    SourceEngine::ExpandingBitStream bit_stream;
+    ByteBuffer buffer;
+    auto size = TRY(write_into(buffer));
+    TRY(buffer.try_resize(size));
+
+    return buffer;
+}
+
+ErrorOr<size_t> SendingPacket::write_into(ByteBuffer& buffer) const
+{
+    SourceEngine::ExpandingBitStream bit_stream(move(buffer));
+
+    // Make room for the whole packet up front
+    TRY(bit_stream.ensure_capacity(TRY(max_size_in_bits())));
+
     TRY(bit_stream << m_sequence);
     TRY(bit_stream << m_sequence_ack);
 
@@ -108,10 +179,9 @@ ErrorOr<ByteBuffer> SendingPacket::write() const
     if (m_choked_number.has_value())
         flags |= Packet::Flags::Choked;
 
-    auto is_reliable = m_reliable_messages.size() > 0;
-
-    if (is_reliable)
-        return Error::from_string_literal("TODO Write reliable messages to packets");
+    auto is_reliable = false;
+    for (auto& channel_fragments : m_channel_fragments)
+        is_reliable |= channel_fragments.has_value();
 
     if (is_reliable)
         flags |= Packet::Flags::Reliable;
@@ -124,7 +194,7 @@ ErrorOr<ByteBuffer> SendingPacket::write() const
     TRY(bit_stream.write_typed<u16>(0));
     auto position_to_checksum_from = TRY(bit_stream.position());
 
-    TRY(bit_stream.write_typed<u8>(0)); // Reliable state
+    TRY(bit_stream << m_reliable_state);
 
     if (m_choked_number.has_value())
         TRY(bit_stream << *m_choked_number);
@@ -135,26 +205,22 @@ ErrorOr<ByteBuffer> SendingPacket::write() const
     if (is_reliable)
     {
         // This is the subchannel index. There are 8 of them.
-        TRY(bit_stream.write_typed<u8>(0, 3));
+        TRY(bit_stream.write_typed(m_subchannel, 3));
 
-        for (auto i = 0; i < static_cast<size_t>(Packet::Channel::__Count); i++)
+        for (auto& channel_fragments : m_channel_fragments)
         {
-            // We don't support any other channel
-            if (static_cast<Packet::Channel>(i) == Packet::Channel::Normal)
-            {
-                TRY(bit_stream.write(true));
-                TRY(bit_stream.write(false)); // Not fragmented
-                TRY(bit_stream.write(false)); // Not compressed
-            }
-            else
+            TRY(bit_stream.write(channel_fragments.has_value()));
+
+            if (channel_fragments.has_value())
             {
-                TRY(bit_stream.write(false));
+                TRY(channel_fragments->sending_channel->write_fragments(bit_stream, channel_fragments->start_fragment,
+                                                                        channel_fragments->number_of_fragments));
             }
         }
     }
 
-    for (auto& message : m_unreliable_messages)
-        TRY(message.write(bit_stream));
+    if (m_unreliable_messages)
+        TRY(m_unreliable_messages->write(bit_stream, m_first_unreliable_message, m_number_of_unreliable_messages));
 
     // Pad the remaining bits explicitly (WE don't have to, but the Engine does, and we have to know how many to pad to
     // put it in the flags)
@@ -176,12 +242,48 @@ ErrorOr<ByteBuffer> SendingPacket::write() const
 
     TRY(bit_stream.set_position(end_position));
 
-    auto checksum = Crypto::Checksum::CRC32(bit_stream.bytes().slice(position_to_checksum_from >> 3)).digest();
+    auto checksum = CRC32(bit_stream.bytes().slice(position_to_checksum_from >> 3)).digest();
     auto compressed_checksum = Packet::compress_checksum_to_u16(checksum);
     TRY(bit_stream.set_position(checksum_position));
     TRY(bit_stream << compressed_checksum);
     TRY(bit_stream.set_position(end_position));
 
-    return bit_stream.release_bytes();
+    auto size = bit_stream.bytes().size();
+    buffer = bit_stream.release_buffer();
+
+    return size;
+}
+
+ErrorOr<size_t> SendingPacket::max_size_in_bits() const
+{
+    // The padding at the end is at most 7 bits
+    auto size_in_bits = max_header_size_in_bits + 7;
+
+    auto is_reliable = false;
+    for (auto& channel_fragments : m_channel_fragments)
+    {
+        if (!channel_fragments.has_value())
+            continue;
+
+        is_reliable = true;
+
+        CountingBitStream stream;
+        TRY(channel_fragments->sending_channel->write_fragments(stream, channel_fragments->start_fragment,
+                                                                channel_fragments->number_of_fragments));
+        size_in_bits += stream.size_in_bits();
+    }
+
+    // The subchannel, and whether each channel has data
+    if (is_reliable)
+        size_in_bits += 3 + Packet::number_of_channels;
+
+    if (m_unreliable_messages)
+    {
+        auto end = m_first_unreliable_message + m_number_of_unreliable_messages;
+        for (auto i = m_first_unreliable_message; i < end; i++)
+            size_in_bits += TRY(m_unreliable_messages->at(i).size_in_bits());
+    }
+
+    return size_in_bits;
 }
 }
\ No newline at end of file
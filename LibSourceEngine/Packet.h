@@ -6,13 +6,15 @@
 
 #pragma once
 
+#include <AK/Array.h>
 #include <AK/EnumBits.h>
 #include <AK/Error.h>
-#include <AK/HashMap.h>
+#include <AK/Optional.h>
 #include <AK/Types.h>
-#include <LibCrypto/Checksum/CRC32.h>
+#include <AK/Vector.h>
 #include <LibSourceEngine/BitStream.h>
 #include <LibSourceEngine/Message.h>
+#include <LibSourceEngine/MessageQueue.h>
 
 namespace SourceEngine
 {
@@ -38,11 +40,21 @@ struct Packet
         __Count
     };
 
+    static constexpr size_t number_of_channels = static_cast<size_t>(Channel::__Count);
+
     // FIXME: Better names, these are the same as the Engine
     static constexpr u32 max_file_size_bits = 26;
     static constexpr u32 fragment_bits = 8;
 
     static constexpr u32 fragment_size = 1 << fragment_bits;
+    static constexpr u32 max_file_size = (1 << max_file_size_bits) - 1;
+
+    // This is the Engine's NET_MAX_PAYLOAD, anything larger than this has to go through the file channel
+    static constexpr u32 max_payload_size = 288000;
+
+    static constexpr u32 number_of_bits_for_fragment_count = 3;
+    // The Engine sends at most net_maxfragments (1260) bytes of fragments in one packet
+    static constexpr u32 max_fragments_per_packet = 1260 / fragment_size;
 };
 
 class ConnectionlessPacket
@@ -50,17 +62,51 @@ class ConnectionlessPacket
 public:
     static constexpr int packet_header = -1;
 
-    ALWAYS_INLINE virtual char id() const = 0;
+    virtual char id() const = 0;
+
+    // The same as Message, these forward to the write templated on the concrete stream (see
+    // TypedConnectionlessPacket).
+    virtual ErrorOr<void> write(WritableBitStream&) const = 0;
+    virtual ErrorOr<void> write(ExpandingBitStream&) const = 0;
+
+    // The same as Message::size_in_bits.
+    virtual ErrorOr<size_t> size_in_bits() const = 0;
+};
+
+template<typename T>
+class TypedConnectionlessPacket : public ConnectionlessPacket
+{
+public:
+    char id() const override { return T::constant_id; }
 
-    ALWAYS_INLINE virtual ErrorOr<void> write(WritableBitStream& stream) const
+    ErrorOr<void> write(WritableBitStream& stream) const override
     {
-        TRY(stream.write_typed(id()));
+        return static_cast<const T&>(*this).write(stream);
+    }
+
+    ErrorOr<void> write(ExpandingBitStream& stream) const override
+    {
+        return static_cast<const T&>(*this).write(stream);
+    }
+
+    ErrorOr<size_t> size_in_bits() const override { return size_in_bits_of(static_cast<const T&>(*this)); }
+
+protected:
+    template<typename Stream>
+    ALWAYS_INLINE ErrorOr<void> write_id(Stream& stream) const
+    {
+        TRY(stream.write_typed(T::constant_id));
         return {};
     }
 };
 
+class ReceivingChannel;
+class SendingChannel;
+
 // Receiving a packet and sending a packet are two vastly different operations, so we have two different types
 
+// Nothing is copied out of the stream that a ReceivingPacket is read from, the channel data and unreliable data refer
+// to the stream's bytes, so those need to outlive the packet.
 class ReceivingPacket
 {
 public:
@@ -70,28 +116,57 @@ public:
         friend ReceivingPacket;
 
         u8 subchannel() const { return m_subchannel; }
-        const ByteBuffer& data() const { return m_data; }
+        BitSpan data() const { return m_data; }
 
     private:
         ChannelData() = default;
-        explicit ChannelData(ByteBuffer&& data) : m_data(move(data)) {}
+        explicit ChannelData(BitSpan data) : m_data(data) {}
         u8 m_subchannel{};
-        ByteBuffer m_data;
+        BitSpan m_data;
     };
 
     // We need a MemoryBitStream here because we need to calculate the checksum from all bytes after the checksum,
     // without consuming them, and this is the best way without performing a redundant allocation.
+    // Fragmented channel data is put together in the connection's ReceivingChannels (one for each channel), and only
+    // shows up in channel_data() once all of it has arrived. Until the next packet is read, it refers to their bytes.
     // FIXME: Would be nice to inline this?
-    static ErrorOr<ReceivingPacket> read(MemoryBitStream& stream);
+    enum class Checksum
+    {
+        Verify,
+        // Only if verify_checksum has already been called on these bytes
+        AlreadyVerified
+    };
+    static ErrorOr<ReceivingPacket> read(MemoryBitStream& stream, Span<ReceivingChannel> channels,
+                                         Checksum = Checksum::Verify);
+
+    // Checks the checksum in the header of a whole datagram against the rest of it. Unlike reading the packet, this
+    // doesn't need anything from the connection, so it can be done before we know who it's from.
+    static ErrorOr<void> verify_checksum(ReadonlyBytes datagram);
 
     int sequence() const { return m_sequence; }
     int sequence_ack() const { return m_sequence_ack; }
+    // See Subchannels::process_acknowledgements
+    u8 reliable_state() const { return m_reliable_state; }
     Optional<int> challenge() const { return m_challenge; }
-    const HashMap<Packet::Channel, ChannelData>& channel_data() const { return m_channel_data; }
-    const ByteBuffer& unreliable_data() const { return m_unreliable_data; }
+    Optional<u8> choked_number() const { return m_choked_number; }
+    // The subchannel the reliable data in this packet came on, only if we could read all of it, as that's when it
+    // should be acknowledged.
+    Optional<u8> subchannel() const { return m_subchannel; }
+    const Optional<ChannelData>& channel_data(Packet::Channel channel) const
+    {
+        return m_channel_data[static_cast<size_t>(channel)];
+    }
+    BitSpan unreliable_data() const { return m_unreliable_data; }
 
 private:
-    ALWAYS_INLINE static ErrorOr<void> read_channel(Packet::Channel, u8 subchannel, MemoryBitStream&, ReceivingPacket&);
+    // The sequence, sequence ack, flags and the checksum itself aren't checksummed
+    static constexpr size_t checksummed_data_offset = sizeof(int) + sizeof(int) + sizeof(u8) + sizeof(u16);
+
+    static ErrorOr<void> verify_checksum(u16 checksum, ReadonlyBytes bytes_to_checksum);
+
+    // Returns false if the rest of the packet can't be read, see ReceivingChannel::read_fragments.
+    ALWAYS_INLINE static ErrorOr<bool> read_channel(Packet::Channel, u8 subchannel, MemoryBitStream&, ReceivingChannel&,
+                                                    ReceivingPacket&);
 
     int m_sequence{};
     int m_sequence_ack{};
@@ -99,34 +174,73 @@ private:
     u8 m_reliable_state{};
     Optional<u8> m_choked_number;
     Optional<int> m_challenge;
-    HashMap<Packet::Channel, ChannelData> m_channel_data;
+    Optional<u8> m_subchannel;
+    Array<Optional<ChannelData>, Packet::number_of_channels> m_channel_data;
     // Unreliable data is stuffed at the end of a packet, if the client has enough room for it.
-    ByteBuffer m_unreliable_data;
+    BitSpan m_unreliable_data;
 };
 
 class SendingPacket
 {
 public:
-    void add_reliable_message(Message& value) { m_reliable_messages.append(value); }
-    void add_unreliable_message(Message& value) { m_unreliable_messages.append(value); };
+    // Reliable messages have to be sent until the other side has them, so they go through a SendingChannel instead (see
+    // Subchannels::add_to_packet). The queue has to outlive the packet.
+    void set_unreliable_messages(const MessageQueue& value) { set_unreliable_messages(value, 0, value.size()); }
+    void set_unreliable_messages(const MessageQueue& value, size_t first, size_t count)
+    {
+        m_unreliable_messages = &value;
+        m_first_unreliable_message = first;
+        m_number_of_unreliable_messages = count;
+    }
 
     void set_sequence(int value) { m_sequence = value; }
     void set_sequence_ack(int value) { m_sequence_ack = value; }
+    void set_reliable_state(u8 value) { m_reliable_state = value; }
     void set_challenge(int value) { m_challenge = value; }
+    // How many packets we would have sent since the last one, but didn't (see PacketPacker)
+    void set_choked_number(u8 value) { m_choked_number = value; }
+
+    // Reliable data is sent on one of 8 subchannels, which is what the other side acknowledges.
+    void set_subchannel(u8 value) { m_subchannel = value; }
+    // Sends number_of_fragments fragments of the data at the front of sending_channel, starting at start_fragment.
+    void set_channel_fragments(Packet::Channel channel, const SendingChannel& sending_channel, u32 start_fragment,
+                               u32 number_of_fragments)
+    {
+        m_channel_fragments[static_cast<size_t>(channel)] =
+            ChannelFragments{&sending_channel, start_fragment, number_of_fragments};
+    }
 
     ErrorOr<ByteBuffer> write() const;
+    // Writes over the start of buffer, and returns how many bytes of it the packet takes up. The buffer stays as large
+    // as it is, so that its memory can be used again (see DatagramBufferPool). It only grows if the packet doesn't fit.
+    ErrorOr<size_t> write_into(ByteBuffer& buffer) const;
+
+    // The header may be a few bytes smaller than this, if it doesn't end up with a choked number or challenge.
+    ErrorOr<size_t> max_size_in_bits() const;
 
 private:
+    struct ChannelFragments
+    {
+        const SendingChannel* sending_channel{};
+        u32 start_fragment{};
+        u32 number_of_fragments{};
+    };
+
+    // Sequence, sequence ack, flags, checksum, reliable state, choked number and challenge. The reliable header is
+    // only a few bits, so we don't bother with it.
+    static constexpr size_t max_header_size_in_bits =
+        (sizeof(int) + sizeof(int) + sizeof(u8) + sizeof(u16) + sizeof(u8) + sizeof(u8) + sizeof(int)) << 3;
+
     int m_sequence{};
     int m_sequence_ack{};
+    u8 m_reliable_state{};
     Optional<u8> m_choked_number;
     Optional<int> m_challenge;
-    // FIXME: This should own the messages. Can't say Vector<Message>, or we'll slice the objects, but we could OwnPtr
-    //        it, but then whoever cals it would need an ownptr to a message? What if we require a Message&& and then
-    //        move it into an ownptr? still might slice it because it wouldn't know the proper size of object it's
-    //        moving into.
-    Vector<Message&> m_reliable_messages;
-    Vector<Message&> m_unreliable_messages;
+    const MessageQueue* m_unreliable_messages{};
+    size_t m_first_unreliable_message{};
+    size_t m_number_of_unreliable_messages{};
+    u8 m_subchannel{};
+    Array<Optional<ChannelFragments>, Packet::number_of_channels> m_channel_fragments;
 };
 }
 
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <LibSourceEngine/PacketPacker.h>
+
+namespace SourceEngine
+{
+PacketPacker::PacketPacker(size_t max_packet_size, size_t max_packets_per_tick)
+    : m_max_packet_size_in_bits(max_packet_size << 3), m_max_packets_per_tick(max_packets_per_tick)
+{
+    // Reliable data could never be sent if we didn't allow at least one fragment, even if it goes over
+    auto room_for_fragments = max_packet_size > max_overhead_size ? max_packet_size - max_overhead_size : 0;
+    m_max_number_of_fragments = max(static_cast<u32>(room_for_fragments >> Packet::fragment_bits), 1u);
+}
+
+ErrorOr<bool> PacketPacker::pack(SendingPacket& packet, int sequence, Subchannels& subchannels,
+                                 const MessageQueue& unreliable_messages)
+{
+    if (m_number_of_packets_this_tick == m_max_packets_per_tick || !m_rate_limiter.can_send())
+    {
+        if (has_unsent_data(subchannels, unreliable_messages))
+            m_is_choked = true;
+
+        return false;
+    }
+
+    if (m_number_of_choked_packets > 0)
+        packet.set_choked_number(m_number_of_choked_packets);
+
+    // A file could fill every packet on its own, so it only gets half of one while there are unreliable messages
+    auto max_number_of_file_fragments = m_max_number_of_fragments;
+    if (m_next_unreliable_message < unreliable_messages.size())
+        max_number_of_file_fragments = max(m_max_number_of_fragments / 2, 1u);
+
+    auto has_reliable_data =
+        subchannels.add_to_packet(packet, sequence, m_max_number_of_fragments, max_number_of_file_fragments);
+    auto size_in_bits = TRY(packet.max_size_in_bits());
+
+    auto first_unreliable_message = m_next_unreliable_message;
+    while (m_next_unreliable_message < unreliable_messages.size())
+    {
+        auto message_size_in_bits = TRY(unreliable_messages.at(m_next_unreliable_message).size_in_bits());
+        if (size_in_bits + message_size_in_bits <= m_max_packet_size_in_bits)
+        {
+            size_in_bits += message_size_in_bits;
+            m_next_unreliable_message++;
+            continue;
+        }
+
+        // If this doesn't fit as the first thing in a packet, it never will
+        if (m_next_unreliable_message == first_unreliable_message && !has_reliable_data)
+        {
+            m_next_unreliable_message++;
+            first_unreliable_message++;
+            continue;
+        }
+
+        break;
+    }
+
+    auto number_of_unreliable_messages = m_next_unreliable_message - first_unreliable_message;
+    if (!has_reliable_data && number_of_unreliable_messages == 0)
+        return false;
+
+    packet.set_unreliable_messages(unreliable_messages, first_unreliable_message, number_of_unreliable_messages);
+
+    m_rate_limiter.consume((size_in_bits + 7) >> 3);
+    m_number_of_packets_this_tick++;
+    m_number_of_choked_packets = 0;
+
+    return true;
+}
+
+bool PacketPacker::end_tick(MessageQueue& unreliable_messages)
+{
+    auto number_of_sent_messages = m_next_unreliable_message;
+
+    // Whatever was held back last tick and still didn't make it is out of date by now
+    auto number_of_dropped_messages =
+        m_number_of_held_messages > number_of_sent_messages ? m_number_of_held_messages - number_of_sent_messages : 0;
+
+    unreliable_messages.remove_first(number_of_sent_messages + number_of_dropped_messages);
+    m_number_of_held_messages = unreliable_messages.size();
+
+    m_number_of_packets_this_tick = 0;
+    m_next_unreliable_message = 0;
+
+    if (!m_is_choked)
+        return false;
+
+    if (m_number_of_choked_packets < NumericLimits<u8>::max())
+        m_number_of_choked_packets++;
+
+    m_is_choked = false;
+    return true;
+}
+
+bool PacketPacker::has_unsent_data(const Subchannels& subchannels, const MessageQueue& unreliable_messages) const
+{
+    return m_next_unreliable_message < unreliable_messages.size() || subchannels.has_unsent_data();
+}
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Error.h>
+#include <AK/Time.h>
+#include <AK/Types.h>
+#include <LibSourceEngine/Channel.h>
+#include <LibSourceEngine/MessageQueue.h>
+#include <LibSourceEngine/Packet.h>
+#include <LibSourceEngine/RateLimiter.h>
+
+namespace SourceEngine
+{
+// Splits everything queued up for a connection during a tick into packets no larger than max_packet_size, so that they
+// don't get fragmented on their way there. Reliable data goes first, as the other side is waiting on it, and then as
+// many unreliable messages as fit. Anything that doesn't make it into max_packets_per_tick packets (or that would go
+// over the connection's rate, see RateLimiter) waits until the next tick, and the packet we held back is reported as
+// choked.
+// Unreliable messages only get to wait for one tick, after that they're out of date, so they're dropped.
+class PacketPacker
+{
+public:
+    // A little under the Engine's net_maxroutable (see SplitPacket), to leave room below an MTU of 1500 for the IP and
+    // UDP headers and any tunnels
+    static constexpr size_t default_max_packet_size = 1200;
+    static constexpr size_t default_max_packets_per_tick = 4;
+
+    explicit PacketPacker(size_t max_packet_size = default_max_packet_size,
+                          size_t max_packets_per_tick = default_max_packets_per_tick);
+
+    RateLimiter& rate_limiter() { return m_rate_limiter; }
+    const RateLimiter& rate_limiter() const { return m_rate_limiter; }
+
+    void begin_tick(Time now) { m_rate_limiter.refill(now); }
+
+    // Fills in the next packet for this tick, which has to be sent with this sequence. Returns false once there's
+    // nothing left to send, or no more room this tick, after which end_tick should be called.
+    ErrorOr<bool> pack(SendingPacket&, int sequence, Subchannels&, const MessageQueue& unreliable_messages);
+
+    // Takes what was sent (or dropped) out of the queue, leaving what is going to wait for the next tick. Returns
+    // whether a packet was choked, which still uses up a sequence, like it does in the Engine (the other side takes the
+    // choked number away from the gap in the sequences, so that it doesn't count choked packets as lost).
+    bool end_tick(MessageQueue& unreliable_messages);
+
+private:
+    // Enough for the header of a packet and the information about the fragments in it
+    static constexpr size_t max_overhead_size = 64;
+
+    bool has_unsent_data(const Subchannels&, const MessageQueue& unreliable_messages) const;
+
+    size_t m_max_packet_size_in_bits{};
+    size_t m_max_packets_per_tick{};
+    u32 m_max_number_of_fragments{};
+    RateLimiter m_rate_limiter;
+
+    size_t m_number_of_packets_this_tick{};
+    // Everything before this has been put into a packet this tick (or dropped because it can never fit into one)
+    size_t m_next_unreliable_message{};
+    // How many of the messages at the front of the queue were already held back last tick
+    size_t m_number_of_held_messages{};
+    bool m_is_choked{};
+    u8 m_number_of_choked_packets{};
+};
+}
\ No newline at end of file
@@ -11,23 +11,24 @@
 
 namespace SourceEngine::Packets::Connectionless::Clientbound
 {
-class Challenge final : public ConnectionlessPacket
+class Challenge final : public TypedConnectionlessPacket<Challenge>
 {
 public:
     static constexpr char constant_id = 'A';
+    static constexpr size_t constant_size_in_bits =
+        (sizeof(char) + sizeof(int) * 4 + sizeof(u16) + sizeof(u64) + sizeof(u8)) << 3;
 
-    ALWAYS_INLINE char id() const override { return constant_id; }
-
-    ErrorOr<void> write(WritableBitStream& stream) const override
+    template<typename Stream>
+    ErrorOr<void> write(Stream& stream) const
     {
-        TRY(ConnectionlessPacket::write(stream));
+        TRY(write_id(stream));
         TRY(stream.write_typed(m_magic_version));
         TRY(stream.write_typed(m_challenge));
         TRY(stream.write_typed(m_client_challenge));
         TRY(stream.write_typed(static_cast<int>(m_auth_protocol)));
-        TRY(stream.write_typed<u16>(0)); // Legacy Steam2 encryption key, doesn't exist anymore
+        TRY(stream.template write_typed<u16>(0)); // Legacy Steam2 encryption key, doesn't exist anymore
         TRY(stream.write_typed(m_steam_id));
-        TRY(stream.write_typed<u8>(m_is_secure ? 1 : 0));
+        TRY(stream.template write_typed<u8>(m_is_secure ? 1 : 0));
 
         return {};
     }
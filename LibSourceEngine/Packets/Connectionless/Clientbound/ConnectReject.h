@@ -10,16 +10,15 @@
 
 namespace SourceEngine::Packets::Connectionless::Clientbound
 {
-class ConnectReject final : public ConnectionlessPacket
+class ConnectReject final : public TypedConnectionlessPacket<ConnectReject>
 {
 public:
     static constexpr char constant_id = '9';
 
-    ALWAYS_INLINE char id() const override { return constant_id; }
-
-    ErrorOr<void> write(WritableBitStream& stream) const override
+    template<typename Stream>
+    ErrorOr<void> write(Stream& stream) const
     {
-        TRY(ConnectionlessPacket::write(stream));
+        TRY(write_id(stream));
         TRY(stream.write_typed(m_challenge));
         TRY(stream << m_reason);
 
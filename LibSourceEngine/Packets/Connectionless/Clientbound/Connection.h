@@ -11,16 +11,16 @@
 
 namespace SourceEngine::Packets::Connectionless::Clientbound
 {
-class Connection final : public ConnectionlessPacket
+class Connection final : public TypedConnectionlessPacket<Connection>
 {
 public:
     static constexpr char constant_id = 'B';
+    static constexpr size_t constant_size_in_bits = (sizeof(char) + sizeof(int)) << 3;
 
-    ALWAYS_INLINE char id() const override { return constant_id; }
-
-    ErrorOr<void> write(WritableBitStream& stream) const override
+    template<typename Stream>
+    ErrorOr<void> write(Stream& stream) const
     {
-        TRY(ConnectionlessPacket::write(stream));
+        TRY(write_id(stream));
         TRY(stream.write_typed(m_challenge));
 
         return {};
@@ -11,14 +11,13 @@
 
 namespace SourceEngine::Packets::Connectionless::Serverbound
 {
-class Connect final : public ConnectionlessPacket
+class Connect final : public TypedConnectionlessPacket<Connect>
 {
 public:
     static constexpr char constant_id = 'k';
 
-    ALWAYS_INLINE char id() const override { return constant_id; }
-
-    ErrorOr<void> write(WritableBitStream& stream) const override
+    template<typename Stream>
+    ErrorOr<void> write(Stream& stream) const
     {
         // TODO: Write a writer!
         return Error::from_string_literal("Unimplemented Connect::write");
@@ -26,11 +25,14 @@ public:
         return {};
     }
 
-    static ErrorOr<Connect> read(ReadableBitStream& stream)
+    // Everything read is a view, either into the stream or scratch, so this can't outlive either of them. In return,
+    // reading doesn't allocate anything.
+    template<typename Stream>
+    static ErrorOr<Connect> read(Stream& stream, Bytes scratch)
     {
         Connect connect;
         TRY(stream >> connect.m_protocol_version);
-        connect.m_auth_protocol = static_cast<AuthProtocol>(TRY(stream.read_typed<int>()));
+        connect.m_auth_protocol = static_cast<AuthProtocol>(TRY(stream.template read_typed<int>()));
 
         // TODO: Support more auth protocols? I doubt there is a reason to, ever.
         if (connect.m_auth_protocol != AuthProtocol::Steam)
@@ -38,11 +40,11 @@ public:
 
         TRY(stream >> connect.m_server_challenge);
         TRY(stream >> connect.m_client_challenge);
-        TRY(stream >> connect.m_client_name);
-        TRY(stream >> connect.m_password);
-        TRY(stream >> connect.m_version_string);
-        auto steam_cookie_length = TRY(stream.read_typed<u16>());
-        connect.m_steam_cookie = TRY(stream.read_bytes(steam_cookie_length));
+        connect.m_client_name = TRY(stream.read_string_view(scratch));
+        connect.m_password = TRY(stream.read_string_view(scratch));
+        connect.m_version_string = TRY(stream.read_string_view(scratch));
+        auto steam_cookie_length = TRY(stream.template read_typed<u16>());
+        connect.m_steam_cookie = TRY(stream.read_bytes_view(steam_cookie_length, scratch));
 
         return connect;
     }
@@ -51,19 +53,19 @@ public:
     AuthProtocol auth_protocol() const { return m_auth_protocol; }
     int server_challenge() const { return m_server_challenge; }
     int client_challenge() const { return m_client_challenge; }
-    const String& client_name() const { return m_client_name; }
-    const String& password() const { return m_password; }
-    const String& version_string() const { return m_version_string; }
-    const ByteBuffer& steam_cookie() const { return m_steam_cookie; }
+    StringView client_name() const { return m_client_name; }
+    StringView password() const { return m_password; }
+    StringView version_string() const { return m_version_string; }
+    ReadonlyBytes steam_cookie() const { return m_steam_cookie; }
 
 private:
     int m_protocol_version{};
     AuthProtocol m_auth_protocol{};
     int m_server_challenge{};
     int m_client_challenge{};
-    String m_client_name;
-    String m_password;
-    String m_version_string;
-    ByteBuffer m_steam_cookie;
+    StringView m_client_name;
+    StringView m_password;
+    StringView m_version_string;
+    ReadonlyBytes m_steam_cookie;
 };
 }
\ No newline at end of file
@@ -10,22 +10,23 @@
 
 namespace SourceEngine::Packets::Connectionless::Serverbound
 {
-class GetChallenge final : public ConnectionlessPacket
+class GetChallenge final : public TypedConnectionlessPacket<GetChallenge>
 {
 public:
     static constexpr char constant_id = 'q';
+    static constexpr size_t constant_size_in_bits = (sizeof(char) + sizeof(int)) << 3;
 
-    ALWAYS_INLINE char id() const override { return constant_id; }
-
-    ErrorOr<void> write(WritableBitStream& stream) const override
+    template<typename Stream>
+    ErrorOr<void> write(Stream& stream) const
     {
-        TRY(ConnectionlessPacket::write(stream));
+        TRY(write_id(stream));
         TRY(stream.write_typed(m_challenge));
 
         return {};
     }
 
-    static ErrorOr<GetChallenge> read(ReadableBitStream& stream)
+    template<typename Stream>
+    static ErrorOr<GetChallenge> read(Stream& stream)
     {
         GetChallenge get_challenge;
         TRY(stream >> get_challenge.m_challenge);
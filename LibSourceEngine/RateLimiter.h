@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Optional.h>
+#include <AK/StdLibExtras.h>
+#include <AK/Time.h>
+#include <AK/Types.h>
+
+namespace SourceEngine
+{
+// Keeps what we send to a connection under its rate (in bytes per second, which the client tells us with its "rate"
+// convar). This is a token bucket: it fills up at the rate, and every packet we send takes its size out of it. Like the
+// Engine, we let a packet go whenever we aren't behind, even if that packet puts us behind, so a packet larger than the
+// bucket can still be sent, and anything after it waits until we've caught up.
+class RateLimiter
+{
+public:
+    // The same limits the Engine puts on the rate convar
+    static constexpr u32 min_rate = 1000;
+    static constexpr u32 max_rate = 1024 * 1024;
+    static constexpr u32 default_rate = 80000;
+
+    // Every packet also has IP and UDP headers, which take up just as much of the link
+    static constexpr size_t packet_overhead_size = 28;
+
+    u32 rate() const { return m_rate; }
+    void set_rate(u32 value)
+    {
+        m_rate = clamp(value, min_rate, max_rate);
+        m_tokens = min(m_tokens, capacity());
+    }
+
+    void refill(Time now)
+    {
+        if (m_last_refill_time.has_value())
+        {
+            auto elapsed_seconds = (now - *m_last_refill_time).to_nanoseconds() / 1'000'000'000.0f;
+            m_tokens = min(m_tokens + elapsed_seconds * m_rate, capacity());
+        }
+        else
+        {
+            m_tokens = capacity();
+        }
+
+        m_last_refill_time = now;
+    }
+
+    bool can_send() const { return m_tokens >= 0.0f; }
+    void consume(size_t packet_size) { m_tokens -= packet_size + packet_overhead_size; }
+
+private:
+    // How much we let build up while there's nothing to send, so that what we send after being quiet for a while can't
+    // go over the rate by more than this
+    static constexpr float max_burst_seconds = 0.1f;
+
+    float capacity() const { return m_rate * max_burst_seconds; }
+
+    u32 m_rate{default_rate};
+    float m_tokens{};
+    Optional<Time> m_last_refill_time;
+};
+}
\ No newline at end of file
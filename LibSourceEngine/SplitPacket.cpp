@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <LibSourceEngine/SplitPacket.h>
+
+namespace SourceEngine
+{
+ErrorOr<Optional<ReadonlyBytes>> SplitPacketReassembler::receive(ReadonlyBytes packet, Time now)
+{
+    if (packet.size() < SplitPacket::header_size)
+        return Error::from_string_literal("Not enough bytes for a split packet header");
+
+    MemoryBitStream stream(packet);
+    if (TRY(stream.read_typed<int>()) != SplitPacket::packet_header)
+        return Error::from_string_literal("Not a split packet");
+
+    auto sequence = TRY(stream.read_typed<int>());
+    auto packet_id = TRY(stream.read_typed<u16>());
+    auto split_size = TRY(stream.read_typed<u16>());
+    auto piece = packet.slice(SplitPacket::header_size);
+
+    auto index = packet_id >> 8;
+    auto number_of_splits = packet_id & 0xFF;
+
+    if (split_size < SplitPacket::min_split_size || split_size > SplitPacket::max_split_size)
+        return Error::from_string_literal("Split packet size is out of range");
+
+    if (number_of_splits == 0 || index >= number_of_splits)
+        return Error::from_string_literal("Split packet index is out of range");
+
+    if (static_cast<size_t>(number_of_splits) * split_size > m_max_datagram_size)
+        return Error::from_string_literal("Split datagram is too large");
+
+    // Every piece but the last is exactly the split size
+    auto is_last = index == number_of_splits - 1;
+    if (piece.is_empty() || piece.size() > split_size || (!is_last && piece.size() != split_size))
+        return Error::from_string_literal("Split packet is the wrong size");
+
+    if (m_last_reassembled_sequence.has_value() && *m_last_reassembled_sequence == sequence)
+        return Optional<ReadonlyBytes>{};
+
+    if (!m_sequence.has_value() || *m_sequence != sequence)
+    {
+        TRY(m_datagram.try_resize(number_of_splits * split_size));
+        m_sequence = sequence;
+        m_number_of_splits = number_of_splits;
+        m_split_size = split_size;
+        m_received_splits = {};
+        m_number_of_received_splits = 0;
+        m_size = 0;
+    }
+    else if (m_number_of_splits != number_of_splits || m_split_size != split_size)
+    {
+        return Error::from_string_literal("Split packet doesn't match the rest of its datagram");
+    }
+
+    m_last_receive_time = now;
+
+    auto& received_splits = m_received_splits[index >> 6];
+    auto bit = 1ull << (index & 63);
+    if (received_splits & bit)
+        return Optional<ReadonlyBytes>{};
+
+    received_splits |= bit;
+    m_number_of_received_splits++;
+    piece.copy_to(m_datagram.bytes().slice(index * split_size));
+
+    if (is_last)
+        m_size = index * split_size + piece.size();
+
+    if (m_number_of_received_splits < m_number_of_splits)
+        return Optional<ReadonlyBytes>{};
+
+    m_sequence.clear();
+    m_last_reassembled_sequence = sequence;
+    return m_datagram.bytes().trim(m_size);
+}
+}
\ No newline at end of file
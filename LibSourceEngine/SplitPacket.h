@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Array.h>
+#include <AK/ByteBuffer.h>
+#include <AK/Endian.h>
+#include <AK/Error.h>
+#include <AK/Optional.h>
+#include <AK/Span.h>
+#include <AK/Time.h>
+#include <AK/Types.h>
+#include <LibSourceEngine/BitStream.h>
+
+namespace SourceEngine
+{
+// The Engine splits any datagram (connectionless or not) that's larger than net_maxroutable into several. Each of them
+// starts with -2 instead of the usual header, then a sequence that all of them share, which one this is (in the high
+// byte) and how many of them there are (in the low byte), and how much of the datagram is in each of them (the last
+// one has whatever is left).
+struct SplitPacket
+{
+    static constexpr int packet_header = -2;
+    static constexpr size_t header_size = sizeof(int) + sizeof(int) + sizeof(u16) + sizeof(u16);
+
+    // What net_maxroutable can be set between, which is how large each of them can be, header included
+    static constexpr size_t min_packet_size = 576;
+    static constexpr size_t max_packet_size = 1260;
+    static constexpr size_t min_split_size = min_packet_size - header_size;
+    static constexpr size_t max_split_size = max_packet_size - header_size;
+
+    // Which one it is and how many there are only get a byte each
+    static constexpr size_t max_number_of_splits = 255;
+
+    struct [[gnu::packed]] Header
+    {
+        LittleEndian<int> packet_header;
+        LittleEndian<int> sequence;
+        LittleEndian<u16> packet_number_and_count;
+        LittleEndian<u16> split_size;
+    };
+    static_assert(sizeof(Header) == header_size);
+
+    // Calls callback with each of the packets the datagram is split into, which are only valid until it returns.
+    template<typename Callback>
+    static ErrorOr<void> split(ReadonlyBytes datagram, int sequence, size_t max_size, Callback callback)
+    {
+        if (max_size < min_packet_size || max_size > max_packet_size)
+            return Error::from_string_literal("Split packet size is out of range");
+
+        auto split_size = max_size - header_size;
+        auto number_of_splits = (datagram.size() + split_size - 1) / split_size;
+        if (number_of_splits > max_number_of_splits)
+            return Error::from_string_literal("Datagram is too large to be split");
+
+        Array<u8, max_packet_size> packet;
+
+        for (size_t i = 0; i < number_of_splits; i++)
+        {
+            auto piece = datagram.slice(i * split_size, min(split_size, datagram.size() - i * split_size));
+
+            // Everything is on a byte boundary, so it can be copied straight in, instead of going through a stream
+            Header header{packet_header, sequence, static_cast<u16>((i << 8) | number_of_splits),
+                          static_cast<u16>(split_size)};
+            __builtin_memcpy(packet.data(), &header, sizeof(header));
+            piece.copy_to(packet.span().slice(header_size));
+
+            TRY(callback(packet.span().trim(header_size + piece.size())));
+        }
+
+        return {};
+    }
+};
+
+// Puts the datagram a source split back together, a piece at a time. Each source only has one datagram being put back
+// together at a time, like in the Engine, so if a piece of a different one comes along, we start over with that one.
+// How much memory this can take is limited by max_datagram_size.
+class SplitPacketReassembler
+{
+public:
+    // The Engine's SPLIT_PACKET_STALE_TIME, after which whatever we have of a datagram is thrown away
+    static constexpr i64 stale_time_milliseconds = 2000;
+
+    explicit SplitPacketReassembler(size_t max_datagram_size) : m_max_datagram_size(max_datagram_size) {}
+
+    // Returns the whole datagram once its last piece arrives, which is valid until the next call.
+    ErrorOr<Optional<ReadonlyBytes>> receive(ReadonlyBytes packet, Time now);
+
+    bool is_stale(Time now) const { return (now - m_last_receive_time).to_milliseconds() > stale_time_milliseconds; }
+
+private:
+    size_t m_max_datagram_size{};
+    ByteBuffer m_datagram;
+    Optional<int> m_sequence;
+    // So that a piece arriving twice doesn't start the datagram over once we've already put it together
+    Optional<int> m_last_reassembled_sequence;
+    u8 m_number_of_splits{};
+    u16 m_split_size{};
+    // Which pieces we've got, a bit for each
+    Array<u64, 4> m_received_splits{};
+    size_t m_number_of_received_splits{};
+    size_t m_size{};
+    Time m_last_receive_time;
+};
+}
\ No newline at end of file
@@ -15,11 +15,39 @@ namespace SourceEngine
 class UserMessage
 {
 public:
-    ALWAYS_INLINE virtual u8 id() const = 0;
+    virtual u8 id() const = 0;
 
-    ALWAYS_INLINE virtual ErrorOr<void> write(WritableBitStream& stream) const
+    // The same as Message, these forward to the write templated on the concrete stream (see TypedUserMessage).
+    virtual ErrorOr<void> write(WritableBitStream&) const = 0;
+    virtual ErrorOr<void> write(ExpandingBitStream&) const = 0;
+
+    // The same as Message::size_in_bits.
+    virtual ErrorOr<size_t> size_in_bits() const = 0;
+};
+
+template<typename T>
+class TypedUserMessage : public UserMessage
+{
+public:
+    u8 id() const override { return T::constant_id; }
+
+    ErrorOr<void> write(WritableBitStream& stream) const override
+    {
+        return static_cast<const T&>(*this).write(stream);
+    }
+
+    ErrorOr<void> write(ExpandingBitStream& stream) const override
+    {
+        return static_cast<const T&>(*this).write(stream);
+    }
+
+    ErrorOr<size_t> size_in_bits() const override { return size_in_bits_of(static_cast<const T&>(*this)); }
+
+protected:
+    template<typename Stream>
+    ALWAYS_INLINE ErrorOr<void> write_id(Stream& stream) const
     {
-        TRY(stream << id());
+        TRY(stream << T::constant_id);
         return {};
     }
 };
@@ -10,17 +10,18 @@
 
 namespace SourceEngine::UserMessages
 {
-class SayText2 final : public UserMessage
+class SayText2 final : public TypedUserMessage<SayText2>
 {
 public:
-    ALWAYS_INLINE u8 id() const override { return 4; }
+    static constexpr u8 constant_id = 4;
 
-    ALWAYS_INLINE ErrorOr<void> write(WritableBitStream& stream) const override
+    template<typename Stream>
+    ALWAYS_INLINE ErrorOr<void> write(Stream& stream) const
     {
-        TRY(UserMessage::write(stream));
+        TRY(write_id(stream));
 
         TRY(stream << m_entity_index);
-        TRY(stream.write_typed<u8>(m_is_chat ? 1 : 0));
+        TRY(stream.template write_typed<u8>(m_is_chat ? 1 : 0));
         TRY(stream << m_message);
 
         for (auto& param : m_params)
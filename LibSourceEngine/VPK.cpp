@@ -8,7 +8,7 @@
 #include <AK/Vector.h>
 #include <LibCore/File.h>
 #include <LibCore/FileStream.h>
-#include <LibCrypto/Checksum/CRC32.h>
+#include <LibSourceEngine/CRC32.h>
 #include <LibSourceEngine/VPK.h>
 
 namespace SourceEngine
@@ -125,7 +125,7 @@ ErrorOr<ByteBuffer> VPK::Entry::read_data_from_archive(bool verify_against_crc)
 
     if (verify_against_crc)
     {
-        Crypto::Checksum::CRC32 crc_checksum;
+        CRC32 crc_checksum;
         crc_checksum.update(buffer.bytes());
 
         if (crc_checksum.digest() != m_crc)
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Format.h>
+#include <AK/HashFunctions.h>
+#include <AK/IPv4Address.h>
+#include <AK/Traits.h>
+#include <netinet/in.h>
+
+// So that addresses can be used as keys (for clients and anything else we keep for each source), and printed
+namespace AK
+{
+template<>
+struct Traits<sockaddr_in> : public GenericTraits<sockaddr_in>
+{
+    static unsigned hash(const sockaddr_in& value)
+    {
+        unsigned hash = 0;
+        // FIXME: Could OR sin_port and sin_family together into one 32-bit value
+        hash = pair_int_hash(hash, value.sin_port);
+        hash = pair_int_hash(hash, value.sin_addr.s_addr);
+        hash = pair_int_hash(hash, value.sin_family);
+        return hash;
+    }
+
+    static constexpr bool equals(const sockaddr_in& a, const sockaddr_in& b)
+    {
+        return a.sin_port == b.sin_port && a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_family == b.sin_family;
+    }
+};
+
+template<>
+struct Formatter<sockaddr_in> : public Formatter<String>
+{
+    ErrorOr<void> format(FormatBuilder& builder, const sockaddr_in& value)
+    {
+        IPv4Address address(value.sin_addr.s_addr);
+        TRY(builder.put_string(address.to_string()));
+        TRY(builder.put_string(":"sv));
+        TRY(builder.put_u64(value.sin_port));
+        return {};
+    }
+};
+}
\ No newline at end of file
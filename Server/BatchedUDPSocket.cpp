@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/Optional.h>
+#include <Server/BatchedUDPSocket.h>
+#include <errno.h>
+#include <sys/uio.h>
+
+BatchedUDPSocket::BatchedUDPSocket(int fd) : m_fd(fd)
+{
+#ifdef __linux__
+    // Everything but the sizes (and the address lengths, which the kernel changes) stays the same for every batch
+    for (size_t i = 0; i < batch_size; i++)
+    {
+        m_receive_iovecs[i] = {m_receive_buffers[i].data(), buffer_size};
+        m_receive_headers[i].msg_hdr.msg_name = &m_receive_addresses[i];
+        m_receive_headers[i].msg_hdr.msg_iov = &m_receive_iovecs[i];
+        m_receive_headers[i].msg_hdr.msg_iovlen = 1;
+
+        m_send_iovecs[i] = {m_send_buffers[i].data(), 0};
+        m_send_headers[i].msg_hdr.msg_name = &m_send_addresses[i];
+        m_send_headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        m_send_headers[i].msg_hdr.msg_iov = &m_send_iovecs[i];
+        m_send_headers[i].msg_hdr.msg_iovlen = 1;
+    }
+#endif
+}
+
+ErrorOr<size_t> BatchedUDPSocket::receive_batch()
+{
+#ifdef __linux__
+    for (auto& header : m_receive_headers)
+    {
+        header.msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        header.msg_hdr.msg_flags = 0;
+    }
+
+    int number_of_datagrams;
+    do
+    {
+        number_of_datagrams = recvmmsg(m_fd, m_receive_headers.data(), batch_size, MSG_DONTWAIT, nullptr);
+    } while (number_of_datagrams < 0 && errno == EINTR);
+
+    if (number_of_datagrams < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return 0;
+
+        return Error::from_errno(errno);
+    }
+
+    for (auto i = 0; i < number_of_datagrams; i++)
+    {
+        auto& header = m_receive_headers[i];
+        auto is_truncated = (header.msg_hdr.msg_flags & MSG_TRUNC) != 0;
+        m_receive_sizes[i] = is_truncated ? buffer_size + 1 : header.msg_len;
+    }
+
+    return static_cast<size_t>(number_of_datagrams);
+#else
+    size_t number_of_datagrams = 0;
+
+    while (number_of_datagrams < batch_size)
+    {
+        iovec iov{m_receive_buffers[number_of_datagrams].data(), buffer_size};
+        msghdr header{};
+        header.msg_name = &m_receive_addresses[number_of_datagrams];
+        header.msg_namelen = sizeof(sockaddr_in);
+        header.msg_iov = &iov;
+        header.msg_iovlen = 1;
+
+        auto size = recvmsg(m_fd, &header, MSG_DONTWAIT);
+        if (size < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+
+            return Error::from_errno(errno);
+        }
+
+        auto is_truncated = (header.msg_flags & MSG_TRUNC) != 0;
+        m_receive_sizes[number_of_datagrams++] = is_truncated ? buffer_size + 1 : static_cast<size_t>(size);
+    }
+
+    return number_of_datagrams;
+#endif
+}
+
+ErrorOr<void> BatchedUDPSocket::enqueue(ReadonlyBytes datagram, const sockaddr_in& destination)
+{
+    if (datagram.size() > buffer_size)
+        return Error::from_string_literal("Datagram is too large to send");
+
+    if (m_number_of_pending_datagrams == batch_size)
+        TRY(flush());
+
+    auto index = m_number_of_pending_datagrams++;
+    datagram.copy_to(m_send_buffers[index].span());
+    m_send_addresses[index] = destination;
+    m_send_sizes[index] = datagram.size();
+
+    return {};
+}
+
+ErrorOr<void> BatchedUDPSocket::flush()
+{
+    Optional<Error> first_error;
+    size_t number_of_sent_datagrams = 0;
+
+#ifdef __linux__
+    for (size_t i = 0; i < m_number_of_pending_datagrams; i++)
+        m_send_iovecs[i].iov_len = m_send_sizes[i];
+#endif
+
+    while (number_of_sent_datagrams < m_number_of_pending_datagrams)
+    {
+#ifdef __linux__
+        auto result = sendmmsg(m_fd, m_send_headers.data() + number_of_sent_datagrams,
+                               m_number_of_pending_datagrams - number_of_sent_datagrams, MSG_DONTWAIT);
+#else
+        auto index = number_of_sent_datagrams;
+        auto result = sendto(m_fd, m_send_buffers[index].data(), m_send_sizes[index], MSG_DONTWAIT,
+                             reinterpret_cast<const sockaddr*>(&m_send_addresses[index]), sizeof(sockaddr_in));
+        if (result >= 0)
+            result = 1;
+#endif
+
+        if (result >= 0)
+        {
+            number_of_sent_datagrams += result;
+            continue;
+        }
+
+        if (errno == EINTR)
+            continue;
+
+        // The send buffer is full, so the rest are lost
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+            break;
+
+        // Only this one failed, so we carry on with the rest
+        if (!first_error.has_value())
+            first_error = Error::from_errno(errno);
+        number_of_sent_datagrams++;
+    }
+
+    m_number_of_pending_datagrams = 0;
+
+    if (first_error.has_value())
+        return first_error.release_value();
+
+    return {};
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Array.h>
+#include <AK/Error.h>
+#include <AK/Noncopyable.h>
+#include <AK/Span.h>
+#include <AK/Types.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+// Receives and sends datagrams on a UDP socket batch_size at a time, with one recvmmsg or sendmmsg for each batch
+// (where we don't have those, it falls back to a recvfrom or sendto for each datagram). Datagrams are received into
+// and sent from a fixed set of buffers, so nothing is allocated for any of them.
+// The socket has to be non-blocking, and the buffers point into this, so it can't be moved.
+class BatchedUDPSocket
+{
+    AK_MAKE_NONCOPYABLE(BatchedUDPSocket);
+    AK_MAKE_NONMOVABLE(BatchedUDPSocket);
+
+public:
+    static constexpr size_t batch_size = 64;
+    // Anything larger than this is thrown away when it's received, and can't be sent
+    static constexpr size_t buffer_size = 2 * KiB;
+
+    explicit BatchedUDPSocket(int fd);
+
+    // Receives up to batch_size datagrams, whatever has arrived, and calls callback with each of them. They're only
+    // valid until it returns. Returns how many there were, so 0 means that there was nothing to receive.
+    template<typename Callback>
+    ErrorOr<size_t> receive(Callback callback)
+    {
+        auto number_of_datagrams = TRY(receive_batch());
+
+        for (size_t i = 0; i < number_of_datagrams; i++)
+        {
+            if (m_receive_sizes[i] > buffer_size)
+                continue;
+
+            callback(m_receive_buffers[i].span().trim(m_receive_sizes[i]), m_receive_addresses[i]);
+        }
+
+        return number_of_datagrams;
+    }
+
+    // Copies the datagram to be sent with the rest of the batch on the next flush. If the batch is already full, it's
+    // flushed first.
+    ErrorOr<void> enqueue(ReadonlyBytes, const sockaddr_in&);
+
+    bool has_pending_datagrams() const { return m_number_of_pending_datagrams > 0; }
+
+    // Sends everything that has been enqueued. Like any other datagram, these can be lost: if the socket's send buffer
+    // fills up, the rest of them are dropped. Anything else the kernel refuses to send is skipped, and the first error
+    // is returned after the others have been sent.
+    ErrorOr<void> flush();
+
+private:
+    ErrorOr<size_t> receive_batch();
+
+    int m_fd{-1};
+
+    Array<Array<u8, buffer_size>, batch_size> m_receive_buffers;
+    Array<sockaddr_in, batch_size> m_receive_addresses{};
+    // This is how large the datagram really was, so it's larger than buffer_size if it didn't fit
+    Array<size_t, batch_size> m_receive_sizes{};
+
+    Array<Array<u8, buffer_size>, batch_size> m_send_buffers;
+    Array<sockaddr_in, batch_size> m_send_addresses{};
+    Array<size_t, batch_size> m_send_sizes{};
+    size_t m_number_of_pending_datagrams{};
+
+#ifdef __linux__
+    Array<iovec, batch_size> m_receive_iovecs{};
+    Array<mmsghdr, batch_size> m_receive_headers{};
+    Array<iovec, batch_size> m_send_iovecs{};
+    Array<mmsghdr, batch_size> m_send_headers{};
+#endif
+};
\ No newline at end of file
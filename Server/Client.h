@@ -6,12 +6,25 @@
 
 #pragma once
 
+#include <AK/Array.h>
 #include <AK/StdLibExtras.h>
+#include <AK/String.h>
+#include <AK/StringView.h>
+#include <LibSourceEngine/BitStream.h>
+#include <LibSourceEngine/Channel.h>
+#include <LibSourceEngine/ConnectionStatistics.h>
+#include <LibSourceEngine/MessageQueue.h>
+#include <LibSourceEngine/PacketPacker.h>
+#include <LibSourceEngine/SignOnState.h>
 #include <netinet/ip.h>
 
 class Client
 {
 public:
+    // What the Engine's cl_updaterate and cl_cmdrate default to
+    static constexpr u32 default_update_rate = 20;
+    static constexpr u32 default_command_rate = 30;
+
     Client(sockaddr_in address) : m_address(move(address)) {}
 
     int client_challenge() const { return m_client_challenge; }
@@ -20,6 +33,17 @@ public:
     int server_packet_sequence() const { return m_server_packet_sequence; }
 
     const sockaddr_in& address() const { return m_address; }
+    const String& name() const { return m_name; }
+    SourceEngine::SignOnState sign_on_state() const { return m_sign_on_state; }
+    // Once we've accepted their Connect, they have a netchannel, and we can send them messages
+    bool is_connected() const { return m_sign_on_state >= SourceEngine::SignOnState::Connected; }
+    // Once they've disconnected, they're only kept until it's safe to remove them (see Server::remove_client_later)
+    bool is_disconnected() const { return m_sign_on_state == SourceEngine::SignOnState::None; }
+    u32 rate() const { return m_packet_packer.rate_limiter().rate(); }
+    u32 update_rate() const { return m_update_rate; }
+    u32 command_rate() const { return m_command_rate; }
+    void set_name(String value) { m_name = move(value); }
+    void set_sign_on_state(SourceEngine::SignOnState value) { m_sign_on_state = value; }
     void set_client_challenge(int value) { m_client_challenge = value; }
     void set_server_challenge(int value) { m_server_challenge = value; }
     void set_client_packet_sequence(int value) { m_client_packet_sequence = value; }
@@ -27,11 +51,68 @@ public:
     int take_next_client_packet_sequence() { return m_client_packet_sequence++; }
     int take_next_server_packet_sequence() { return m_server_packet_sequence++; }
 
+    // Clients tell us about the convars that matter to us with SetConVar, we only keep the ones we do something with
+    void set_convar(StringView name, StringView value)
+    {
+        auto maybe_value = value.to_uint<u32>();
+        if (!maybe_value.has_value())
+            return;
+
+        if (name == "rate"sv)
+            m_packet_packer.rate_limiter().set_rate(*maybe_value);
+        else if (name == "cl_updaterate"sv)
+            m_update_rate = *maybe_value;
+        else if (name == "cl_cmdrate"sv)
+            m_command_rate = *maybe_value;
+    }
+
+    Span<SourceEngine::ReceivingChannel> receiving_channels() { return m_receiving_channels; }
+    SourceEngine::Subchannels& subchannels() { return m_subchannels; }
+    SourceEngine::PacketPacker& packet_packer() { return m_packet_packer; }
+    SourceEngine::ConnectionStatistics& statistics() { return m_statistics; }
+
+    // Messages are held onto until the end of the tick, so they can all be sent together
+    SourceEngine::MessageQueue& reliable_messages() { return m_reliable_messages; }
+    SourceEngine::MessageQueue& unreliable_messages() { return m_unreliable_messages; }
+
+    ErrorOr<void> enqueue_reliable_messages()
+    {
+        if (m_reliable_messages.is_empty())
+            return {};
+
+        SourceEngine::ExpandingBitStream stream;
+        TRY(stream.ensure_capacity(TRY(m_reliable_messages.size_in_bits()) + 7));
+        TRY(m_reliable_messages.write(stream));
+        m_reliable_messages.clear();
+
+        // Whatever is left in the last byte reads as a NOP
+        auto position = TRY(stream.position());
+        if ((position & 7) != 0)
+            TRY(stream.write_typed<u8>(0, 8 - (position & 7)));
+
+        TRY(m_subchannels.sending_channel(SourceEngine::Packet::Channel::Normal).enqueue(
+            SourceEngine::Packet::Channel::Normal, TRY(stream.release_bytes())));
+
+        return {};
+    }
+
 private:
     sockaddr_in m_address;
+    String m_name;
+    // Asking for a challenge is how clients start talking to us, so that's as far as they've got to begin with
+    SourceEngine::SignOnState m_sign_on_state{SourceEngine::SignOnState::Challenge};
     int m_client_challenge{}; // This is the challenge this client gave us
     int m_server_challenge{}; // This is the challenge we gave the client
-    // Sequences always start at 1
+    // Sequences always start at 1. For the client, this is the next one we expect, anything before it has been seen
     int m_client_packet_sequence{1};
     int m_server_packet_sequence{1};
+    // How many snapshots the client wants from us, and how many commands it sends us, each second
+    u32 m_update_rate{default_update_rate};
+    u32 m_command_rate{default_command_rate};
+    Array<SourceEngine::ReceivingChannel, SourceEngine::Packet::number_of_channels> m_receiving_channels;
+    SourceEngine::Subchannels m_subchannels;
+    SourceEngine::PacketPacker m_packet_packer;
+    SourceEngine::ConnectionStatistics m_statistics;
+    SourceEngine::MessageQueue m_reliable_messages;
+    SourceEngine::MessageQueue m_unreliable_messages;
 };
\ No newline at end of file
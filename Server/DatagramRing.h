@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Atomic.h>
+#include <AK/ByteBuffer.h>
+#include <AK/Error.h>
+#include <AK/Noncopyable.h>
+#include <AK/NonnullOwnPtr.h>
+#include <AK/NumericLimits.h>
+#include <AK/Span.h>
+#include <AK/Time.h>
+#include <AK/Types.h>
+#include <errno.h>
+#include <netinet/in.h>
+
+// Hands datagrams (and who they're from or for, and when they were received) from one thread to another without
+// locking. Exactly one thread may push, and exactly one may pop. Datagrams are copied into a buffer of a fixed size,
+// one after another, so nothing is allocated once it's created, and anything that doesn't fit is dropped, like it would
+// be if a socket's buffer filled up. Several of these, each with their own producer, can be popped by the same thread.
+class DatagramRing
+{
+    AK_MAKE_NONCOPYABLE(DatagramRing);
+    AK_MAKE_NONMOVABLE(DatagramRing);
+
+public:
+    // The size has to be a power of two
+    static ErrorOr<NonnullOwnPtr<DatagramRing>> try_create(size_t size)
+    {
+        if (size == 0 || (size & (size - 1)) != 0)
+            return Error::from_string_literal("Datagram ring size must be a power of two");
+
+        auto bytes = TRY(ByteBuffer::create_uninitialized(size));
+        auto* ring = new (nothrow) DatagramRing(move(bytes));
+        if (!ring)
+            return Error::from_errno(ENOMEM);
+
+        return adopt_own(*ring);
+    }
+
+    // Only from the pushing thread. Returns false if there's no room for it.
+    bool try_push(ReadonlyBytes datagram, const sockaddr_in& address, Time received_time = {})
+    {
+        auto record_size = align_up(sizeof(Header) + datagram.size());
+        // Otherwise it might never fit, depending on where it ends up
+        if (record_size > m_bytes.size() / 2)
+            return false;
+
+        auto head = m_head.load(AK::MemoryOrder::memory_order_relaxed);
+        auto index = head & (m_bytes.size() - 1);
+
+        // Records don't wrap around, so if this doesn't fit before the end, it goes at the beginning instead
+        size_t padding = 0;
+        if (m_bytes.size() - index < record_size)
+            padding = m_bytes.size() - index;
+
+        auto tail = m_tail.load(AK::MemoryOrder::memory_order_acquire);
+        if (head + padding + record_size - tail > m_bytes.size())
+            return false;
+
+        if (padding >= sizeof(Header))
+        {
+            Header wrap_header{wrap_marker, {}, {}};
+            __builtin_memcpy(m_bytes.data() + index, &wrap_header, sizeof(wrap_header));
+        }
+
+        auto* record = m_bytes.data() + ((head + padding) & (m_bytes.size() - 1));
+        Header header{static_cast<u32>(datagram.size()), address, received_time};
+        __builtin_memcpy(record, &header, sizeof(header));
+        __builtin_memcpy(record + sizeof(header), datagram.data(), datagram.size());
+
+        m_head.store(head + padding + record_size, AK::MemoryOrder::memory_order_release);
+        return true;
+    }
+
+    // Only from the popping thread. Calls callback with every datagram pushed so far, which are only valid until it
+    // returns, and returns how many there were.
+    template<typename Callback>
+    size_t pop_all(Callback callback)
+    {
+        auto tail = m_tail.load(AK::MemoryOrder::memory_order_relaxed);
+        auto head = m_head.load(AK::MemoryOrder::memory_order_acquire);
+        size_t number_of_datagrams = 0;
+
+        while (tail != head)
+        {
+            auto index = tail & (m_bytes.size() - 1);
+            auto space_to_end = m_bytes.size() - index;
+
+            Header header;
+            if (space_to_end >= sizeof(Header))
+                __builtin_memcpy(&header, m_bytes.data() + index, sizeof(header));
+
+            // The next one is at the beginning, as it didn't fit here
+            if (space_to_end < sizeof(Header) || header.size == wrap_marker)
+            {
+                tail += space_to_end;
+                continue;
+            }
+
+            callback(m_bytes.span().slice(index + sizeof(Header), header.size), header.address, header.received_time);
+            number_of_datagrams++;
+
+            // It has been dealt with, so the pushing thread can have its room back
+            tail += align_up(sizeof(Header) + header.size);
+            m_tail.store(tail, AK::MemoryOrder::memory_order_release);
+        }
+
+        m_tail.store(tail, AK::MemoryOrder::memory_order_release);
+        return number_of_datagrams;
+    }
+
+private:
+    struct Header
+    {
+        u32 size{};
+        sockaddr_in address{};
+        Time received_time{};
+    };
+
+    // Every record starts at a multiple of this, so that the space left before the end always is too
+    static constexpr size_t record_alignment = 8;
+    // Instead of a size, this says that there's nothing more until the beginning
+    static constexpr u32 wrap_marker = NumericLimits<u32>::max();
+
+    static constexpr size_t align_up(size_t size) { return (size + record_alignment - 1) & ~(record_alignment - 1); }
+
+    explicit DatagramRing(ByteBuffer&& bytes) : m_bytes(move(bytes)) {}
+
+    ByteBuffer m_bytes;
+    // These only ever go up, where they are in m_bytes is what they are modulo its size. They're on separate cache
+    // lines, so that the two threads aren't fighting over one.
+    alignas(64) Atomic<size_t> m_head{0};
+    alignas(64) Atomic<size_t> m_tail{0};
+};
\ No newline at end of file
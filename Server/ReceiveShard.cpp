@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/Format.h>
+#include <LibCore/SocketAddress.h>
+#include <LibSourceEngine/Packet.h>
+#include <Server/ReceiveShard.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+ErrorOr<NonnullOwnPtr<ReceiveShard>> ReceiveShard::try_create(const IPv4Address& address, u16 port)
+{
+    auto fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+        return Error::from_errno(errno);
+
+    auto close_and_return_error = [&]() -> Error {
+        auto error = Error::from_errno(errno);
+        close(fd);
+        return error;
+    };
+
+    int enable = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) < 0)
+        return close_and_return_error();
+
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0)
+        return close_and_return_error();
+
+    auto socket_address = Core::SocketAddress(address, port).to_sockaddr_in();
+    if (::bind(fd, reinterpret_cast<const sockaddr*>(&socket_address), sizeof(socket_address)) < 0)
+        return close_and_return_error();
+
+    auto maybe_received = DatagramRing::try_create(received_ring_size);
+    if (maybe_received.is_error())
+    {
+        close(fd);
+        return maybe_received.release_error();
+    }
+
+    auto* shard = new (nothrow) ReceiveShard(fd, maybe_received.release_value());
+    if (!shard)
+    {
+        close(fd);
+        return Error::from_errno(ENOMEM);
+    }
+
+    return adopt_own(*shard);
+}
+
+ReceiveShard::ReceiveShard(int fd, NonnullOwnPtr<DatagramRing> received)
+    : m_fd(fd), m_socket(fd), m_received(move(received))
+{
+}
+
+ReceiveShard::~ReceiveShard()
+{
+    m_should_stop.store(true);
+    if (m_thread)
+        (void)m_thread->join();
+
+    close(m_fd);
+}
+
+void ReceiveShard::start()
+{
+    m_thread = Threading::Thread::construct(
+        [this]() -> intptr_t {
+            run();
+            return 0;
+        },
+        "ReceiveShard"sv);
+    m_thread->start();
+}
+
+void ReceiveShard::run()
+{
+    pollfd poll_fd{m_fd, POLLIN, 0};
+    auto last_stale_removal_time = Time::now_monotonic();
+
+    while (!m_should_stop.load())
+    {
+        // Timing out or being interrupted are both fine, we just check whether we should stop and go again
+        if (poll(&poll_fd, 1, poll_timeout_milliseconds) <= 0)
+            continue;
+
+        // Everything in this batch arrived before we woke up. The server only gets to it at the start of its next tick,
+        // so this is what round trip times and jitter are measured from (see ConnectionStatistics).
+        auto now = Time::now_monotonic();
+        auto maybe_number_of_datagrams =
+            m_socket.receive([&](ReadonlyBytes bytes, sockaddr_in& from) { receive(bytes, from, now); });
+
+        if (maybe_number_of_datagrams.is_error())
+            warnln("\u001b[31mError whilst receiving: \u001b[35m{}\u001b[0m", maybe_number_of_datagrams.error());
+
+        // The server does this every tick, but we don't need to be nearly that often
+        if ((now - last_stale_removal_time).to_milliseconds() > stale_removal_interval_milliseconds)
+        {
+            m_split_packet_sources.remove_stale(now);
+            last_stale_removal_time = now;
+        }
+    }
+}
+
+void ReceiveShard::receive(ReadonlyBytes bytes, const sockaddr_in& from, Time received_time)
+{
+    // Anything that doesn't make it through is dropped here, like the Engine does with packets it can't read, as we
+    // can't disconnect anyone from this thread
+    auto drop = [&](const Error& error) {
+        warnln("\u001b[31mError whilst receiving from {}: \u001b[35m{}\u001b[0m", from, error);
+    };
+
+    if (bytes.size() < sizeof(int))
+        return drop(Error::from_string_literal("Not enough bytes for even a connectionless packet header"));
+
+    if (*reinterpret_cast<const int*>(bytes.data()) == SourceEngine::SplitPacket::packet_header)
+    {
+        auto maybe_datagram = m_split_packet_sources.receive(bytes, from, received_time);
+        if (maybe_datagram.is_error())
+            return drop(maybe_datagram.release_error());
+
+        if (!maybe_datagram.value().has_value())
+            return;
+
+        bytes = *maybe_datagram.value();
+        if (bytes.size() < sizeof(int))
+            return drop(Error::from_string_literal("Not enough bytes for even a connectionless packet header"));
+    }
+
+    // Connectionless packets don't have a checksum
+    if (*reinterpret_cast<const int*>(bytes.data()) != SourceEngine::ConnectionlessPacket::packet_header)
+    {
+        auto maybe_error = SourceEngine::ReceivingPacket::verify_checksum(bytes);
+        if (maybe_error.is_error())
+            return drop(maybe_error.release_error());
+    }
+
+    // If there's no room, the server is too far behind, so it's dropped
+    (void)m_received->try_push(bytes, from, received_time);
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Atomic.h>
+#include <AK/Error.h>
+#include <AK/IPv4Address.h>
+#include <AK/Noncopyable.h>
+#include <AK/NonnullOwnPtr.h>
+#include <AK/StdLibExtras.h>
+#include <AK/Time.h>
+#include <LibThreading/Thread.h>
+#include <Server/BatchedUDPSocket.h>
+#include <Server/DatagramRing.h>
+#include <Server/SplitPacketSources.h>
+
+// When the server receives on several threads, each of them has one of these. They all have their own socket, bound to
+// the same port with SO_REUSEPORT, and the kernel picks which one gets a datagram by hashing where it came from, so the
+// same source always ends up in the same shard. Each shard receives on its own thread, puts split packets back together
+// and verifies checksums there, and hands the datagrams that make it through to the server (through a DatagramRing),
+// which takes them at the start of its next tick. Everything else happens on the server's thread, as that's where the
+// connections are.
+class ReceiveShard
+{
+    AK_MAKE_NONCOPYABLE(ReceiveShard);
+    AK_MAKE_NONMOVABLE(ReceiveShard);
+
+public:
+    // If the server falls this far behind, anything more is dropped, as it would be if the socket's buffer filled up
+    static constexpr size_t received_ring_size = 4 * MiB;
+
+    static ErrorOr<NonnullOwnPtr<ReceiveShard>> try_create(const IPv4Address&, u16 port);
+    ~ReceiveShard();
+
+    // We can send on the socket from any thread, every shard's socket has the same address
+    int fd() const { return m_fd; }
+
+    void start();
+
+    // Calls callback with each datagram received since the last time this was called, where it came from, and when it
+    // arrived. Their checksums have already been verified (see ReceivingPacket::Checksum), and they're only valid until
+    // it returns.
+    template<typename Callback>
+    void take_received(Callback callback)
+    {
+        m_received->pop_all(callback);
+    }
+
+private:
+    ReceiveShard(int fd, NonnullOwnPtr<DatagramRing> received);
+
+    void run();
+    void receive(ReadonlyBytes, const sockaddr_in& from, Time received_time);
+
+    // How long the thread waits for something to arrive before checking whether it should stop
+    static constexpr int poll_timeout_milliseconds = 100;
+    static constexpr i64 stale_removal_interval_milliseconds = 1000;
+
+    int m_fd{-1};
+    BatchedUDPSocket m_socket;
+    SplitPacketSources m_split_packet_sources;
+    RefPtr<Threading::Thread> m_thread;
+    Atomic<bool> m_should_stop{false};
+
+    // The shard's thread pushes, and the server pops
+    NonnullOwnPtr<DatagramRing> m_received;
+};
\ No newline at end of file
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/Array.h>
+#include <AK/Format.h>
+#include <Server/AddressTraits.h>
+#include <Server/SendThread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+ErrorOr<NonnullOwnPtr<SendThread>> SendThread::try_create(int fd)
+{
+    auto to_send = TRY(DatagramRing::try_create(send_ring_size));
+
+    int wake_fds[2];
+    if (pipe(wake_fds) < 0)
+        return Error::from_errno(errno);
+
+    // Waking up a thread that already has something to wake up for doesn't need to block us
+    for (auto wake_fd : wake_fds)
+    {
+        if (fcntl(wake_fd, F_SETFL, fcntl(wake_fd, F_GETFL) | O_NONBLOCK) < 0 ||
+            fcntl(wake_fd, F_SETFD, FD_CLOEXEC) < 0)
+        {
+            auto error = Error::from_errno(errno);
+            close(wake_fds[0]);
+            close(wake_fds[1]);
+            return error;
+        }
+    }
+
+    auto* send_thread = new (nothrow) SendThread(fd, wake_fds[0], wake_fds[1], move(to_send));
+    if (!send_thread)
+    {
+        close(wake_fds[0]);
+        close(wake_fds[1]);
+        return Error::from_errno(ENOMEM);
+    }
+
+    return adopt_own(*send_thread);
+}
+
+SendThread::SendThread(int fd, int wake_read_fd, int wake_write_fd, NonnullOwnPtr<DatagramRing> to_send)
+    : m_socket(fd), m_wake_read_fd(wake_read_fd), m_wake_write_fd(wake_write_fd), m_to_send(move(to_send))
+{
+}
+
+SendThread::~SendThread()
+{
+    m_should_stop.store(true);
+    if (m_thread)
+    {
+        wake();
+        (void)m_thread->join();
+    }
+
+    close(m_wake_read_fd);
+    close(m_wake_write_fd);
+}
+
+void SendThread::start()
+{
+    m_thread = Threading::Thread::construct(
+        [this]() -> intptr_t {
+            run();
+            return 0;
+        },
+        "SendThread"sv);
+    m_thread->start();
+}
+
+void SendThread::wake()
+{
+    // If the pipe is full, the thread has plenty to wake up for already
+    u8 byte = 0;
+    (void)write(m_wake_write_fd, &byte, sizeof(byte));
+}
+
+void SendThread::run()
+{
+    pollfd poll_fd{m_wake_read_fd, POLLIN, 0};
+
+    while (!m_should_stop.load())
+    {
+        if (poll(&poll_fd, 1, poll_timeout_milliseconds) <= 0)
+            continue;
+
+        // However many times we were woken up, we send everything at once
+        Array<u8, 64> wake_bytes;
+        while (read(m_wake_read_fd, wake_bytes.data(), wake_bytes.size()) > 0)
+            ;
+
+        m_to_send->pop_all([this](ReadonlyBytes datagram, sockaddr_in& destination, Time) {
+            auto maybe_error = m_socket.enqueue(datagram, destination);
+            if (maybe_error.is_error())
+                warnln("\u001b[31mError whilst sending to {}: \u001b[35m{}\u001b[0m", destination, maybe_error.error());
+        });
+
+        if (!m_socket.has_pending_datagrams())
+            continue;
+
+        auto maybe_error = m_socket.flush();
+        if (maybe_error.is_error())
+            warnln("\u001b[31mError whilst sending: \u001b[35m{}\u001b[0m", maybe_error.error());
+    }
+}
\ No newline at end of file
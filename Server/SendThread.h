@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Atomic.h>
+#include <AK/Error.h>
+#include <AK/Noncopyable.h>
+#include <AK/NonnullOwnPtr.h>
+#include <LibThreading/Thread.h>
+#include <Server/BatchedUDPSocket.h>
+#include <Server/DatagramRing.h>
+
+// Sends datagrams from its own thread, so that the tick doesn't have to wait on the system calls. The server pushes
+// them into a DatagramRing, and wakes this up once it has pushed everything for the tick, at which point they're all
+// sent in as few batches as they fit in (see BatchedUDPSocket).
+class SendThread
+{
+    AK_MAKE_NONCOPYABLE(SendThread);
+    AK_MAKE_NONMOVABLE(SendThread);
+
+public:
+    // About a tick's worth of full packets for a few hundred clients
+    static constexpr size_t send_ring_size = 4 * MiB;
+
+    static ErrorOr<NonnullOwnPtr<SendThread>> try_create(int fd);
+    ~SendThread();
+
+    void start();
+
+    // Only from the server's thread. If the thread has fallen so far behind that there's no room, this is dropped.
+    void enqueue(ReadonlyBytes datagram, const sockaddr_in& destination)
+    {
+        (void)m_to_send->try_push(datagram, destination);
+    }
+
+    // Tells the thread that there's something to send.
+    void wake();
+
+private:
+    SendThread(int fd, int wake_read_fd, int wake_write_fd, NonnullOwnPtr<DatagramRing> to_send);
+
+    void run();
+
+    // How long the thread waits to be woken up before checking whether it should stop
+    static constexpr int poll_timeout_milliseconds = 100;
+
+    BatchedUDPSocket m_socket;
+    // A pipe that wake writes into, which the thread waits on
+    int m_wake_read_fd{-1};
+    int m_wake_write_fd{-1};
+    NonnullOwnPtr<DatagramRing> m_to_send;
+    RefPtr<Threading::Thread> m_thread;
+    Atomic<bool> m_should_stop{false};
+};
\ No newline at end of file
@@ -6,10 +6,12 @@
 
 #include <LibCrypto/Hash/MD5.h>
 #include <LibSourceEngine/BitStream.h>
+#include <LibSourceEngine/EncodedMessage.h>
 #include <LibSourceEngine/Messages/Clientbound/CreateStringTable.h>
 #include <LibSourceEngine/Messages/Clientbound/Print.h>
 #include <LibSourceEngine/Messages/Clientbound/ServerInfo.h>
 #include <LibSourceEngine/Messages/Disconnect.h>
+#include <LibSourceEngine/Messages/File.h>
 #include <LibSourceEngine/Messages/SetConVar.h>
 #include <LibSourceEngine/Messages/SignOnState.h>
 #include <LibSourceEngine/Messages/Tick.h>
@@ -20,29 +22,70 @@
 #include <LibSourceEngine/Packets/Connectionless/Serverbound/GetChallenge.h>
 #include <Server/Server.h>
 
-Server::Server(String map_name, SourceEngine::BSP map)
-    : m_server(Core::UDPServer::construct()), m_map_name(move(map_name)), m_map(move(map))
+Server::Server(String map_name, SourceEngine::BSP map, Optional<SourceEngine::VPK> vpk)
+    : m_server(Core::UDPServer::construct()), m_map_name(move(map_name)), m_map(move(map)), m_vpk(move(vpk))
 {
-    m_server->on_ready_to_receive = [this] {
-        sockaddr_in from{};
-        auto bytes = m_server->receive(bytes_to_receive, from);
-        try_or_disconnect(receive(bytes, from), from);
-    };
 }
 
-ErrorOr<void> Server::bind(const IPv4Address& address, u16 port)
+void Server::receive_all()
+{
+    // Only one batch, anything left will wake us up again, so that we don't spend too long without ticking
+    auto now = Time::now_monotonic();
+    auto maybe_number_of_datagrams = m_socket->receive(
+        [&](ReadonlyBytes bytes, sockaddr_in& from) { try_or_disconnect(receive(bytes, from, now), from); });
+
+    if (maybe_number_of_datagrams.is_error())
+        warnln("\u001b[31mError whilst receiving: \u001b[35m{}\u001b[0m", maybe_number_of_datagrams.error());
+
+    // Replies to connectionless packets shouldn't have to wait for the tick
+    flush_socket();
+}
+
+void Server::flush_socket()
 {
-    if (!m_server->bind(address, port))
-        return Error::from_string_literal("Failed to bind");
+    if (m_send_thread)
+    {
+        m_send_thread->wake();
+        return;
+    }
+
+    if (!m_socket->has_pending_datagrams())
+        return;
+
+    auto maybe_error = m_socket->flush();
+    if (maybe_error.is_error())
+        warnln("\u001b[31mError whilst sending: \u001b[35m{}\u001b[0m", maybe_error.error());
+}
+
+ErrorOr<void> Server::bind(const IPv4Address& address, u16 port, size_t number_of_receive_threads)
+{
+    if (number_of_receive_threads == 0)
+    {
+        if (!m_server->bind(address, port))
+            return Error::from_string_literal("Failed to bind");
+
+        m_socket = TRY(try_make<BatchedUDPSocket>(m_server->fd()));
+        m_server->on_ready_to_receive = [this] { receive_all(); };
+
+        return {};
+    }
+
+    for (size_t i = 0; i < number_of_receive_threads; i++)
+        TRY(m_receive_shards.try_append(TRY(ReceiveShard::try_create(address, port))));
+
+    m_send_thread = TRY(SendThread::try_create(m_receive_shards.first()->fd()));
+
+    for (auto& shard : m_receive_shards)
+        shard->start();
+    m_send_thread->start();
 
     return {};
 }
 
 int Server::exec()
 {
-    // FIXME: The first tick of the server will take milliseconds_per_tick milliseconds. Do we care _that_ much?
-    // FIXME: Honestly, millisecond accuracy isn't that great... can we can get more accurate?
-    m_tick_timer = Core::Timer::create_repeating(milliseconds_per_tick, [this] {
+    auto tick_interval = Time::from_nanoseconds(static_cast<i64>(milliseconds_per_tick * 1'000'000));
+    auto maybe_tick_scheduler = TickScheduler::try_create(tick_interval, [this] {
         auto maybe_tick_error = tick();
 
         if (maybe_tick_error.is_error())
@@ -51,7 +94,20 @@ int Server::exec()
             m_event_loop.quit(1);
         }
     });
-    m_tick_timer->start();
+
+    if (maybe_tick_scheduler.is_error())
+    {
+        warnln("\u001b[31mError whilst scheduling ticks: \u001b[35m{}\u001b[0m", maybe_tick_scheduler.error());
+        return 1;
+    }
+
+    m_tick_scheduler = maybe_tick_scheduler.release_value();
+    if (auto maybe_error = m_tick_scheduler->start(); maybe_error.is_error())
+    {
+        warnln("\u001b[31mError whilst scheduling ticks: \u001b[35m{}\u001b[0m", maybe_error.error());
+        return 1;
+    }
+
     return m_event_loop.exec();
 }
 
@@ -60,9 +116,7 @@ ErrorOr<void> Server::disconnect(Client& client, String reason)
     // Can't remove the client TOO soon, we might still be using it, so remove it once we're certainly not doing
     // anything with it, so defer it for later.
     // We do this absolutely first to be sure they aren't considered a client anymore, even if any TRYs fail.
-
-    // TODO: Ensure taking the client by ref here is okay? Does it die?
-    m_event_loop.deferred_invoke([this, &client] { m_clients.remove(client.address()); });
+    remove_client_later(client);
 
     // FIXME: Depending on how far this client has connected, it might be more appropriate (or required!) to
     //        use a different packet. We are only using the connectionless ConnectReject packet here
@@ -76,22 +130,144 @@ ErrorOr<void> Server::disconnect(Client& client, String reason)
     return {};
 }
 
+void Server::remove_client_later(Client& client)
+{
+    client.set_sign_on_state(SourceEngine::SignOnState::None);
+
+    // Adding a client can move all of them, so only the address is safe to hold on to
+    m_event_loop.deferred_invoke([this, address = client.address()] {
+        auto maybe_client = m_clients.find(address);
+        if (maybe_client != m_clients.end() && maybe_client->value.is_disconnected())
+            m_clients.remove(address);
+    });
+}
+
 ErrorOr<void> Server::send(const SourceEngine::ConnectionlessPacket& packet, const sockaddr_in& destination)
 {
-    SourceEngine::ExpandingBitStream bit_stream;
+    auto buffer = TRY(m_buffer_pool.take());
+
+    SourceEngine::ExpandingBitStream bit_stream(move(buffer.byte_buffer()));
+    TRY(bit_stream.ensure_capacity((sizeof(SourceEngine::ConnectionlessPacket::packet_header) << 3) +
+                                   TRY(packet.size_in_bits())));
     TRY(bit_stream.write_typed(SourceEngine::ConnectionlessPacket::packet_header));
     TRY(packet.write(bit_stream));
 
-    auto bytes = bit_stream.bytes();
-    TRY(m_server->send(bytes, destination));
+    // Back to the pool with it once we're done, as large as it was
+    auto size = bit_stream.bytes().size();
+    buffer.byte_buffer() = bit_stream.release_buffer();
+    TRY(send_datagram(buffer.bytes().trim(size), destination));
 
     return {};
 }
 
 ErrorOr<void> Server::send(const SourceEngine::SendingPacket& packet, const sockaddr_in& destination)
 {
-    auto buffer = TRY(packet.write());
-    TRY(m_server->send(buffer.bytes(), destination));
+    auto buffer = TRY(m_buffer_pool.take());
+    auto size = TRY(packet.write_into(buffer.byte_buffer()));
+    TRY(send_datagram(buffer.bytes().trim(size), destination));
+
+    return {};
+}
+
+ErrorOr<void> Server::send_datagram(ReadonlyBytes datagram, const sockaddr_in& destination)
+{
+    auto enqueue = [&](ReadonlyBytes packet) -> ErrorOr<void> {
+        if (m_send_thread)
+        {
+            m_send_thread->enqueue(packet, destination);
+            return {};
+        }
+
+        return m_socket->enqueue(packet, destination);
+    };
+
+    if (datagram.size() <= max_datagram_size)
+        return enqueue(datagram);
+
+    TRY(SourceEngine::SplitPacket::split(datagram, m_split_packet_sequence++, max_datagram_size, enqueue));
+
+    return {};
+}
+
+ErrorOr<void> Server::send_file(Client& client, u32 transfer_id, const String& filename)
+{
+    auto& file_channel = client.subchannels().sending_channel(SourceEngine::Packet::Channel::File);
+    if (file_channel.has_file(filename))
+        return {};
+
+    auto maybe_error = enqueue_file(file_channel, transfer_id, filename);
+    if (!maybe_error.is_error())
+        return {};
+
+    // None of these are the client's fault, so they're only told they can't have it
+    outln("Not sending \"{}\": {}", filename, maybe_error.error());
+
+    SourceEngine::Messages::File denied_file;
+    denied_file.set_transfer_id(transfer_id);
+    denied_file.set_filename(filename);
+    denied_file.set_is_requested(false);
+    TRY(client.reliable_messages().enqueue(move(denied_file)));
+
+    return {};
+}
+
+ErrorOr<void> Server::enqueue_file(SourceEngine::SendingChannel& file_channel, u32 transfer_id,
+                                   const String& filename)
+{
+    if (file_channel.number_of_files() >= max_number_of_queued_files)
+        return Error::from_string_literal("Too many files are already on their way");
+
+    // The map is already in memory, so it's sent straight from there
+    if (filename == String::formatted("maps/{}.bsp", m_map_name))
+        return file_channel.enqueue_file(transfer_id, filename, m_map.bytes());
+
+    if (!m_vpk.has_value())
+        return Error::from_string_literal("No such file");
+
+    auto entry = TRY(m_vpk->entry(filename));
+    return file_channel.enqueue_file(transfer_id, filename, TRY(entry->read_data_from_archive()));
+}
+
+ErrorOr<void> Server::broadcast(const SourceEngine::Message& message)
+{
+    auto encoded_message = TRY(SourceEngine::EncodedMessage::encode(message));
+
+    for (auto& client : m_clients)
+    {
+        // Anyone who has only asked for a challenge has no netchannel to send it down
+        if (client.value.is_connected())
+            TRY(client.value.reliable_messages().enqueue(encoded_message));
+    }
+
+    return {};
+}
+
+ErrorOr<void> Server::flush(Client& client)
+{
+    TRY(client.enqueue_reliable_messages());
+
+    auto now = Time::now_monotonic();
+    auto& packet_packer = client.packet_packer();
+    packet_packer.begin_tick(now);
+
+    while (true)
+    {
+        SourceEngine::SendingPacket packet;
+        if (!TRY(packet_packer.pack(packet, client.server_packet_sequence(), client.subchannels(),
+                                    client.unreliable_messages())))
+            break;
+
+        auto sequence = client.take_next_server_packet_sequence();
+        packet.set_sequence(sequence);
+        packet.set_sequence_ack(client.client_packet_sequence() - 1);
+        packet.set_challenge(client.server_challenge());
+        TRY(send(packet, client.address()));
+
+        client.statistics().sent(sequence, now);
+    }
+
+    if (packet_packer.end_tick(client.unreliable_messages()))
+        client.take_next_server_packet_sequence();
 
     return {};
 }
@@ -100,8 +276,31 @@ ErrorOr<void> Server::tick()
 {
     auto tick_beginning_time = Time::now_monotonic();
 
+    m_split_packet_sources.remove_stale(tick_beginning_time);
+
+    // Everything the receive threads have for us, like the Engine, which reads its sockets at the start of each frame
+    for (auto& shard : m_receive_shards)
+    {
+        shard->take_received([this](ReadonlyBytes bytes, sockaddr_in& from, Time received_time) {
+            try_or_disconnect(
+                receive(bytes, from, received_time, SourceEngine::ReceivingPacket::Checksum::AlreadyVerified), from);
+        });
+    }
+
     // TODO: actually tick something
 
+    for (auto& client : m_clients)
+    {
+        // Anyone who disconnected in what we just drained is still here until the event loop removes them
+        if (client.value.is_disconnected())
+            continue;
+
+        auto address = client.key;
+        try_or_disconnect(flush(client.value), address);
+    }
+
+    flush_socket();
+
     auto tick_ending_time = Time::now_monotonic();
     auto tick_duration_time = tick_ending_time - tick_beginning_time;
     // to_milliseconds will round up to a full millisecond, so let's calculate it ourselves from the nanoseconds
@@ -115,23 +314,36 @@ ErrorOr<void> Server::tick()
         warnln("\u001b[35mTick took too long! {} additional milliseconds passed.\u001b[0m",
                tick_additional_milliseconds);
 
-    m_tick_timer->set_interval(max(milliseconds_per_tick - tick_duration_accurate_milliseconds, 0.0f));
+    m_tick_count++;
 
     return {};
 }
 
-ErrorOr<void> Server::receive(ByteBuffer& bytes, sockaddr_in& from)
+ErrorOr<void> Server::receive_split_packet(ReadonlyBytes bytes, sockaddr_in& from, Time received_time)
+{
+    auto maybe_datagram = TRY(m_split_packet_sources.receive(bytes, from, received_time));
+    if (!maybe_datagram.has_value())
+        return {};
+
+    return receive(*maybe_datagram, from, received_time);
+}
+
+ErrorOr<void> Server::receive(ReadonlyBytes bytes, sockaddr_in& from, Time received_time,
+                              SourceEngine::ReceivingPacket::Checksum checksum)
 {
     if (bytes.size() < sizeof(SourceEngine::ConnectionlessPacket::packet_header))
         return Error::from_string_literal("Not enough bytes for even a connectionless packet header");
 
+    auto peeked_header = *reinterpret_cast<const int*>(bytes.data());
+    if (peeked_header == SourceEngine::SplitPacket::packet_header)
+        return receive_split_packet(bytes, from, received_time);
+
     auto maybe_client_iterator = m_clients.find(from);
     Client* maybe_client{};
     if (maybe_client_iterator != m_clients.end())
         maybe_client = &maybe_client_iterator->value;
 
-    SourceEngine::MemoryBitStream bit_stream(bytes.bytes());
-    auto peeked_header = *reinterpret_cast<const int*>(bytes.data());
+    SourceEngine::MemoryBitStream bit_stream(bytes);
     if (peeked_header == SourceEngine::ConnectionlessPacket::packet_header)
     {
         TRY(bit_stream.skip(sizeof(SourceEngine::ConnectionlessPacket::packet_header) << 3));
@@ -145,7 +357,9 @@ ErrorOr<void> Server::receive(ByteBuffer& bytes, sockaddr_in& from)
                     TRY(SourceEngine::Packets::Connectionless::Serverbound::GetChallenge::read(bit_stream));
                 outln("Client wants a challenge, they have {}", get_challenge_packet.challenge());
 
-                VERIFY(m_clients.set(from, {from}) == AK::HashSetResult::InsertedNewEntry);
+                // Whether they're retrying or reconnecting (maybe after disconnecting earlier in the same batch),
+                // asking again starts over
+                m_clients.set(from, {from});
                 auto& client = m_clients.find(from)->value;
 
                 client.set_client_challenge(get_challenge_packet.challenge());
@@ -166,15 +380,20 @@ ErrorOr<void> Server::receive(ByteBuffer& bytes, sockaddr_in& from)
 
             case SourceEngine::Packets::Connectionless::Serverbound::Connect::constant_id:
             {
+                // Connectionless packets are byte aligned, so this should never actually be used
+                Array<u8, bytes_to_receive> scratch;
                 auto connect_packet =
-                    TRY(SourceEngine::Packets::Connectionless::Serverbound::Connect::read(bit_stream));
+                    TRY(SourceEngine::Packets::Connectionless::Serverbound::Connect::read(bit_stream, scratch));
 
-                if (!maybe_client)
+                if (!maybe_client || maybe_client->is_disconnected())
                     return Error::from_string_literal("Client tried to connect without asking for a challenge");
 
                 outln("{} is connecting with password {}, {} steam cookie length", connect_packet.client_name(),
                       connect_packet.password(), connect_packet.steam_cookie().size());
 
+                maybe_client->set_name(connect_packet.client_name());
+                maybe_client->set_sign_on_state(SourceEngine::SignOnState::Connected);
+
                 SourceEngine::Packets::Connectionless::Clientbound::Connection connection;
 
                 connection.set_challenge(maybe_client->client_challenge());
@@ -187,15 +406,40 @@ ErrorOr<void> Server::receive(ByteBuffer& bytes, sockaddr_in& from)
     }
     else
     {
-        auto packet = TRY(SourceEngine::ReceivingPacket::read(bit_stream));
+        if (!maybe_client)
+            return Error::from_string_literal("Got a packet from someone who isn't connected");
+
+        // Anything else they sent before they're removed is ignored, so that nothing brings them back
+        if (maybe_client->is_disconnected())
+            return {};
+
+        // This is the sequence. The Engine drops anything it has already seen (or anything older), and so do we, or we
+        // would acknowledge the same reliable data twice.
+        if (peeked_header < maybe_client->client_packet_sequence())
+        {
+            maybe_client->statistics().received_out_of_order();
+            return {};
+        }
+
+        auto packet =
+            TRY(SourceEngine::ReceivingPacket::read(bit_stream, maybe_client->receiving_channels(), checksum));
 
-        auto process_messages = [&](ReadonlyBytes bytes) -> ErrorOr<void> {
-            SourceEngine::MemoryBitStream message_bit_stream(bytes);
+        maybe_client->set_client_packet_sequence(packet.sequence() + 1);
+        maybe_client->statistics().received(packet, received_time);
+        maybe_client->statistics().acknowledged(TRY(
+            maybe_client->subchannels().process_acknowledgements(packet.reliable_state(), packet.sequence_ack())));
+        if (packet.subchannel().has_value())
+            maybe_client->subchannels().acknowledge_received(*packet.subchannel());
+
+        auto process_messages = [&](SourceEngine::BitSpan data) -> ErrorOr<void> {
+            SourceEngine::MemoryBitStream message_bit_stream(data);
 
             size_t last_message_position;
 
-            while (bytes.size() >
-                   (TRY(message_bit_stream.position()) + SourceEngine::Message::number_of_bits_for_message_id) >> 3)
+            // Nothing after a Disconnect counts, like anything in a packet that arrives after it
+            while (!maybe_client->is_disconnected() &&
+                   message_bit_stream.size_in_bits() >
+                       TRY(message_bit_stream.position()) + SourceEngine::Message::number_of_bits_for_message_id)
             {
                 auto cmd = TRY(message_bit_stream.read_typed<u8>(6));
 
@@ -208,18 +452,35 @@ ErrorOr<void> Server::receive(ByteBuffer& bytes, sockaddr_in& from)
                         // This is a NOP
                         break;
                     }
+                    case SourceEngine::Messages::File::constant_id:
+                    {
+                        auto file = TRY(SourceEngine::Messages::File::read(message_bit_stream));
+
+                        // Otherwise, they're telling us that they don't want something we were sending them
+                        if (!file.is_requested())
+                            break;
+
+                        outln("Client asked for file \"{}\"", file.filename());
+                        TRY(send_file(*maybe_client, file.transfer_id(), file.filename()));
+
+                        break;
+                    }
                     case SourceEngine::Messages::Disconnect::constant_id:
                     {
                         auto disconnect = TRY(SourceEngine::Messages::Disconnect::read(message_bit_stream));
                         outln("Client disconnected because \"{}\"", disconnect.reason());
-                        m_event_loop.deferred_invoke(
-                            [this, maybe_client] { m_clients.remove(maybe_client->address()); });
+                        remove_client_later(*maybe_client);
 
                         break;
                     }
                     case SourceEngine::Messages::SetConVar::constant_id:
                     {
-                        TRY(SourceEngine::Messages::SetConVar::read(message_bit_stream));
+                        Array<u8, bytes_to_receive> scratch;
+                        TRY(SourceEngine::Messages::SetConVar::read_each(
+                            message_bit_stream, scratch, [&](StringView name, StringView value) -> ErrorOr<void> {
+                                maybe_client->set_convar(name, value);
+                                return {};
+                            }));
                         break;
                     }
                     case SourceEngine::Messages::SignOnState::constant_id:
@@ -258,9 +519,16 @@ ErrorOr<void> Server::receive(ByteBuffer& bytes, sockaddr_in& from)
                             server_info.set_is_replay(false);
 
                             SourceEngine::Messages::Clientbound::Print print;
-                            print.set_message("This is a Wanda server, bruh");
+                            print.set_message(String::formatted("{} joined this Wanda server", maybe_client->name()));
 
+                            auto& frame_time_statistics = m_tick_scheduler->frame_time_statistics();
                             SourceEngine::Messages::Tick tick;
+                            tick.set_tick(m_tick_count);
+                            tick.set_host_frame_time(
+                                SourceEngine::Messages::Tick::frame_time_from_seconds(frame_time_statistics.mean()));
+                            tick.set_host_frame_time_standard_deviation(
+                                SourceEngine::Messages::Tick::frame_time_from_seconds(
+                                    frame_time_statistics.standard_deviation()));
 
                             SourceEngine::Messages::Clientbound::CreateStringTable create_string_table;
                             create_string_table.set_name("downloadables");
@@ -269,15 +537,16 @@ ErrorOr<void> Server::receive(ByteBuffer& bytes, sockaddr_in& from)
                             sign_on_state_message.set_sign_on_state(SourceEngine::SignOnState::New);
                             sign_on_state_message.set_spawn_count(0);
 
-                            SourceEngine::SendingPacket sending_packet;
-                            sending_packet.set_sequence(maybe_client->take_next_server_packet_sequence());
-                            sending_packet.set_challenge(maybe_client->server_challenge());
-                            sending_packet.add_unreliable_message(print);
-                            sending_packet.add_unreliable_message(server_info);
-                            sending_packet.add_unreliable_message(tick);
-                            sending_packet.add_unreliable_message(create_string_table);
-                            sending_packet.add_unreliable_message(sign_on_state_message);
-                            TRY(send(sending_packet, from));
+                            // Everyone hears about it, including them, so it's written once for all of them. The rest
+                            // is just for them, and all of it goes out together at the end of the tick.
+                            TRY(broadcast(print));
+
+                            auto& reliable_messages = maybe_client->reliable_messages();
+                            TRY(reliable_messages.enqueue(move(server_info)));
+                            TRY(reliable_messages.enqueue(move(tick)));
+                            TRY(reliable_messages.enqueue(move(create_string_table)));
+                            TRY(reliable_messages.enqueue(move(sign_on_state_message)));
+                            maybe_client->set_sign_on_state(SourceEngine::SignOnState::New);
                         }
 
                         break;
@@ -292,16 +561,12 @@ ErrorOr<void> Server::receive(ByteBuffer& bytes, sockaddr_in& from)
             return {};
         };
 
-        auto& channel_data = packet.channel_data();
-        auto maybe_normal_channel_data_iterator = channel_data.find(SourceEngine::Packet::Channel::Normal);
-        if (maybe_normal_channel_data_iterator != channel_data.end())
-        {
-            auto& normal_channel_data = maybe_normal_channel_data_iterator->value;
-            TRY(process_messages(normal_channel_data.data().bytes()));
-        }
+        auto& maybe_normal_channel_data = packet.channel_data(SourceEngine::Packet::Channel::Normal);
+        if (maybe_normal_channel_data.has_value())
+            TRY(process_messages(maybe_normal_channel_data->data()));
 
-        if (packet.unreliable_data().size() > 0)
-            TRY(process_messages(packet.unreliable_data().bytes()));
+        if (!packet.unreliable_data().is_empty())
+            TRY(process_messages(packet.unreliable_data()));
     }
 
     return {};
@@ -314,8 +579,9 @@ void Server::try_or_disconnect(ErrorOr<T> maybe_error, sockaddr_in& from)
     {
         warnln("\u001b[31mError whilst receiving from {}: \u001b[35m{}\u001b[0m", from, maybe_error.error());
 
+        // If they've already been disconnected, they've already been told why
         auto maybe_client = m_clients.find(from);
-        if (maybe_client != m_clients.end())
+        if (maybe_client != m_clients.end() && !maybe_client->value.is_disconnected())
         {
             auto& client = maybe_client->value;
 
@@ -9,83 +9,98 @@
 #include <AK/Format.h>
 #include <AK/HashMap.h>
 #include <LibCore/EventLoop.h>
-#include <LibCore/Timer.h>
 #include <LibCore/UDPServer.h>
 #include <LibSourceEngine/BSP.h>
+#include <LibSourceEngine/DatagramBufferPool.h>
 #include <LibSourceEngine/Message.h>
 #include <LibSourceEngine/Packet.h>
+#include <LibSourceEngine/SplitPacket.h>
+#include <LibSourceEngine/VPK.h>
+#include <Server/AddressTraits.h>
+#include <Server/BatchedUDPSocket.h>
 #include <Server/Client.h>
+#include <Server/ReceiveShard.h>
+#include <Server/SendThread.h>
+#include <Server/SplitPacketSources.h>
+#include <Server/TickScheduler.h>
 
 class Server
 {
 public:
     // FIXME: Can we avoid passing the map name around like this? We need to tell the client it, should the Server be
     //        told to load the map from file instead?
-    Server(String map_name, SourceEngine::BSP);
+    // Clients can download the map, and anything in the VPK, if they don't have it.
+    Server(String map_name, SourceEngine::BSP, Optional<SourceEngine::VPK>);
 
-    ErrorOr<void> bind(const IPv4Address&, u16 port);
+    // With any receive threads, each of them gets its own socket on the port (see ReceiveShard), and what they receive
+    // is handled at the start of each tick. Everything is sent from another thread too (see SendThread), so the tick
+    // never waits on the network. Otherwise, everything is received on our thread as soon as it arrives.
+    ErrorOr<void> bind(const IPv4Address&, u16 port, size_t number_of_receive_threads = 0);
     int exec();
 
     // We actually do need to own this String
     ErrorOr<void> disconnect(Client&, String reason);
     ErrorOr<void> send(const SourceEngine::ConnectionlessPacket&, const sockaddr_in&);
     ErrorOr<void> send(const SourceEngine::SendingPacket&, const sockaddr_in&);
+    // Everything sent is held on to until this is called at the end of the tick (or after receiving), so that all of it
+    // goes out in as few system calls as we can.
+    void flush_socket();
+    // Queues the same reliable message for every client that has connected, but only writes it once
+    ErrorOr<void> broadcast(const SourceEngine::Message&);
 
 private:
     ErrorOr<void> tick();
-    ErrorOr<void> receive(ByteBuffer&, sockaddr_in& from);
+    // Sends everything that was queued up for the client during the tick, and whatever reliable data they still need
+    // from us (including acknowledging what we've received from them).
+    ErrorOr<void> flush(Client&);
+    // Receives everything that has arrived on the socket, a batch at a time.
+    void receive_all();
+    ErrorOr<void> receive(ReadonlyBytes, sockaddr_in& from, Time received_time,
+                          SourceEngine::ReceivingPacket::Checksum = SourceEngine::ReceivingPacket::Checksum::Verify);
+    // Once a whole datagram has been put back together, it's received like any other.
+    ErrorOr<void> receive_split_packet(ReadonlyBytes, sockaddr_in& from, Time received_time);
+    // Anything larger than max_datagram_size is split up (see SplitPacket).
+    ErrorOr<void> send_datagram(ReadonlyBytes, const sockaddr_in&);
+    // Starts sending a file the client asked for on the file channel, or tells them they can't have it. Asking for a
+    // file that's already on its way does nothing, like it does in the Engine.
+    ErrorOr<void> send_file(Client&, u32 transfer_id, const String& filename);
+    ErrorOr<void> enqueue_file(SourceEngine::SendingChannel&, u32 transfer_id, const String& filename);
 
     template<typename T>
     void try_or_disconnect(ErrorOr<T>, sockaddr_in&);
+    // Everything received in a batch (or a tick) is handled before the event loop gets to this, so the client can still
+    // be used until then. If their address has asked for a new challenge by then, that's a new connection, which stays.
+    void remove_client_later(Client&);
 
     Core::EventLoop m_event_loop;
-    RefPtr<Core::Timer> m_tick_timer;
+    OwnPtr<TickScheduler> m_tick_scheduler;
+    int m_tick_count{};
+    // This only binds the socket and tells us when there's something to receive, the socket does everything else. With
+    // receive threads, neither is used, and the send thread sends on the first shard's socket instead.
     NonnullRefPtr<Core::UDPServer> m_server;
+    OwnPtr<BatchedUDPSocket> m_socket;
+    Vector<NonnullOwnPtr<ReceiveShard>> m_receive_shards;
+    OwnPtr<SendThread> m_send_thread;
+    // What we write packets into before the socket takes a copy of them. That happens straight away, so there's only
+    // ever one in use, which every packet is written into.
+    SourceEngine::DatagramBufferPool m_buffer_pool{SourceEngine::DatagramBufferPool::default_buffer_size, 1};
     HashMap<sockaddr_in, Client> m_clients;
+    SplitPacketSources m_split_packet_sources;
+    int m_split_packet_sequence{1};
     String m_map_name;
     SourceEngine::BSP m_map;
+    Optional<SourceEngine::VPK> m_vpk;
 
     static constexpr float milliseconds_per_tick = 1000.0 / 66.0;
     static constexpr size_t bytes_to_receive = 2 * KiB;
+    // Nothing we pack is larger than this, so only connectionless packets should ever need splitting
+    static constexpr size_t max_datagram_size = SourceEngine::PacketPacker::default_max_packet_size;
+    // Files from the VPK are read into memory until they've been sent, so each client can only wait on so many of them
+    static constexpr size_t max_number_of_queued_files = 8;
     static constexpr int challenge_magic_version = 0x5A4F4933;
 
     // NOTE: You probably don't want this if you're actually running a server!
     // This may expose internal information about the server, the clients connection or other clients, without any
     // regard to it. For debugging, you probably want it on.
     static constexpr bool show_try_or_disconnect_errors_to_clients = true;
-};
-
-namespace AK
-{
-template<>
-struct Traits<sockaddr_in> : public GenericTraits<sockaddr_in>
-{
-    static unsigned hash(const sockaddr_in& value)
-    {
-        unsigned hash = 0;
-        // FIXME: Could OR sin_port and sin_family together into one 32-bit value
-        hash = pair_int_hash(hash, value.sin_port);
-        hash = pair_int_hash(hash, value.sin_addr.s_addr);
-        hash = pair_int_hash(hash, value.sin_family);
-        return hash;
-    }
-
-    static constexpr bool equals(const sockaddr_in& a, const sockaddr_in& b)
-    {
-        return a.sin_port == b.sin_port && a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_family == b.sin_family;
-    }
-};
-
-template<>
-struct Formatter<sockaddr_in> : public Formatter<String>
-{
-    ErrorOr<void> format(FormatBuilder& builder, const sockaddr_in& value)
-    {
-        IPv4Address address(value.sin_addr.s_addr);
-        TRY(builder.put_string(address.to_string()));
-        TRY(builder.put_string(":"sv));
-        TRY(builder.put_u64(value.sin_port));
-        return {};
-    }
-};
-}
\ No newline at end of file
+};
\ No newline at end of file
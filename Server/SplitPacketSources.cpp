@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <Server/SplitPacketSources.h>
+
+ErrorOr<Optional<ReadonlyBytes>> SplitPacketSources::receive(ReadonlyBytes packet, const sockaddr_in& from, Time now)
+{
+    auto reassembler_iterator = m_reassemblers.find(from);
+    if (reassembler_iterator == m_reassemblers.end())
+    {
+        if (m_reassemblers.size() >= max_number_of_sources)
+            remove_stale(now);
+
+        // Everyone else is still in the middle of theirs, so this source will have to wait until there's room
+        if (m_reassemblers.size() >= max_number_of_sources)
+            return Optional<ReadonlyBytes>{};
+
+        m_reassemblers.set(from, SourceEngine::SplitPacketReassembler(max_datagram_size));
+        reassembler_iterator = m_reassemblers.find(from);
+    }
+
+    auto maybe_datagram = TRY(reassembler_iterator->value.receive(packet, now));
+    if (!maybe_datagram.has_value())
+        return Optional<ReadonlyBytes>{};
+
+    auto datagram = *maybe_datagram;
+    if (datagram.size() >= sizeof(int) &&
+        *reinterpret_cast<const int*>(datagram.data()) == SourceEngine::SplitPacket::packet_header)
+    {
+        return Error::from_string_literal("Split packet was split again");
+    }
+
+    return datagram;
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Error.h>
+#include <AK/HashMap.h>
+#include <AK/Optional.h>
+#include <AK/Time.h>
+#include <LibSourceEngine/SplitPacket.h>
+#include <Server/AddressTraits.h>
+
+// Puts split packets back together for each source that's in the middle of sending us one. How much memory this can
+// take is limited, both for each source and by how many sources it keeps at once.
+class SplitPacketSources
+{
+public:
+    static constexpr size_t max_datagram_size = 16 * KiB;
+    static constexpr size_t max_number_of_sources = 64;
+
+    // Returns the whole datagram once its last piece arrives, which is valid until the next call. If every source we
+    // can keep is still in the middle of theirs, this one is ignored until there's room.
+    ErrorOr<Optional<ReadonlyBytes>> receive(ReadonlyBytes packet, const sockaddr_in& from, Time now);
+
+    void remove_stale(Time now)
+    {
+        m_reassemblers.remove_all_matching([&](auto&, auto& reassembler) { return reassembler.is_stale(now); });
+    }
+
+private:
+    HashMap<sockaddr_in, SourceEngine::SplitPacketReassembler> m_reassemblers;
+};
\ No newline at end of file
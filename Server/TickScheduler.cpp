@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/Format.h>
+#include <AK/Math.h>
+#include <Server/TickScheduler.h>
+#include <errno.h>
+#include <unistd.h>
+#ifdef __linux__
+#    include <sys/timerfd.h>
+#endif
+
+void FrameTimeStatistics::add(float seconds)
+{
+    if (m_number_of_samples == window_size)
+    {
+        auto oldest = m_samples[m_next_sample];
+        m_sum -= oldest;
+        m_sum_of_squares -= static_cast<double>(oldest) * oldest;
+    }
+    else
+    {
+        m_number_of_samples++;
+    }
+
+    m_samples[m_next_sample] = seconds;
+    m_next_sample = (m_next_sample + 1) % window_size;
+    m_sum += seconds;
+    m_sum_of_squares += static_cast<double>(seconds) * seconds;
+}
+
+float FrameTimeStatistics::standard_deviation() const
+{
+    if (m_number_of_samples < 2)
+        return 0.0f;
+
+    auto mean = m_sum / m_number_of_samples;
+    // Taking the samples back out can leave this a little under zero, when it should be zero
+    auto variance = max(m_sum_of_squares / m_number_of_samples - mean * mean, 0.0);
+    return static_cast<float>(AK::sqrt(variance));
+}
+
+ErrorOr<NonnullOwnPtr<TickScheduler>> TickScheduler::try_create(Time interval, Function<void()> on_tick)
+{
+    int timer_fd = -1;
+#ifdef __linux__
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd < 0)
+        return Error::from_errno(errno);
+#endif
+
+    auto* scheduler = new (nothrow) TickScheduler(timer_fd, interval, move(on_tick));
+    if (!scheduler)
+    {
+        if (timer_fd >= 0)
+            close(timer_fd);
+        return Error::from_errno(ENOMEM);
+    }
+
+    return adopt_own(*scheduler);
+}
+
+TickScheduler::TickScheduler(int timer_fd, Time interval, Function<void()> on_tick)
+    : m_timer_fd(timer_fd), m_interval(interval),
+      m_max_lag(Time::from_nanoseconds(interval.to_nanoseconds() * max_number_of_catch_up_ticks)),
+      m_on_tick(move(on_tick))
+{
+#ifdef __linux__
+    m_notifier = Core::Notifier::construct(m_timer_fd, Core::Notifier::Read);
+    m_notifier->on_ready_to_read = [this] { run_tick(); };
+#else
+    m_timer = Core::Timer::create_single_shot(0, [this] { run_tick(); });
+#endif
+}
+
+TickScheduler::~TickScheduler()
+{
+    if (m_notifier)
+        m_notifier->set_enabled(false);
+
+    if (m_timer_fd >= 0)
+        close(m_timer_fd);
+}
+
+ErrorOr<void> TickScheduler::start()
+{
+    m_next_deadline = Time::now_monotonic();
+    return arm();
+}
+
+ErrorOr<void> TickScheduler::arm()
+{
+#ifdef __linux__
+    itimerspec timer_spec{};
+    timer_spec.it_value = m_next_deadline.to_timespec();
+    // A zero deadline would disarm it instead, and the monotonic clock has been going for longer than that anyway
+    if (timer_spec.it_value.tv_sec == 0 && timer_spec.it_value.tv_nsec == 0)
+        timer_spec.it_value.tv_nsec = 1;
+
+    if (timerfd_settime(m_timer_fd, TFD_TIMER_ABSTIME, &timer_spec, nullptr) < 0)
+        return Error::from_errno(errno);
+#else
+    auto milliseconds = max((m_next_deadline - Time::now_monotonic()).to_milliseconds(), static_cast<i64>(0));
+    m_timer->restart(static_cast<int>(milliseconds));
+#endif
+
+    return {};
+}
+
+void TickScheduler::run_tick()
+{
+#ifdef __linux__
+    // This is how many times the deadline has passed, which is always once, as we only ever set one at a time
+    u64 number_of_expirations;
+    if (read(m_timer_fd, &number_of_expirations, sizeof(number_of_expirations)) < 0 && errno == EAGAIN)
+        return;
+#endif
+
+    auto now = Time::now_monotonic();
+
+    // The fallback timer can only wait whole milliseconds, so it may wake us up a little early
+    if (now < m_next_deadline)
+    {
+        if (auto maybe_error = arm(); maybe_error.is_error())
+            warnln("\u001b[31mError whilst scheduling tick: \u001b[35m{}\u001b[0m", maybe_error.error());
+        return;
+    }
+
+    if (m_last_tick_time.has_value())
+        m_frame_time_statistics.add((now - *m_last_tick_time).to_nanoseconds() / 1'000'000'000.0f);
+    m_last_tick_time = now;
+
+    m_on_tick();
+
+    // If we're still behind after this, the next one is due straight away, so we catch up
+    m_next_deadline = m_next_deadline + m_interval;
+    if (m_next_deadline + m_max_lag < now)
+    {
+        warnln("\u001b[35mFell more than {} ticks behind, skipping ahead.\u001b[0m", max_number_of_catch_up_ticks);
+        m_next_deadline = now;
+    }
+
+    if (auto maybe_error = arm(); maybe_error.is_error())
+        warnln("\u001b[31mError whilst scheduling tick: \u001b[35m{}\u001b[0m", maybe_error.error());
+}
\ No newline at end of file
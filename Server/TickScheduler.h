@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Array.h>
+#include <AK/Error.h>
+#include <AK/Function.h>
+#include <AK/Noncopyable.h>
+#include <AK/NonnullOwnPtr.h>
+#include <AK/Optional.h>
+#include <AK/Time.h>
+#include <LibCore/Notifier.h>
+#include <LibCore/Timer.h>
+
+// The mean and standard deviation of the time between the last window_size ticks, which is what the Engine sends
+// clients as the host frame time (see Messages::Tick).
+class FrameTimeStatistics
+{
+public:
+    static constexpr size_t window_size = 64;
+
+    void add(float seconds);
+
+    float mean() const { return m_number_of_samples > 0 ? m_sum / m_number_of_samples : 0.0f; }
+    float standard_deviation() const;
+
+private:
+    Array<float, window_size> m_samples{};
+    size_t m_next_sample{};
+    size_t m_number_of_samples{};
+    // Kept as each sample comes and goes, so that neither needs to go over the whole window
+    double m_sum{};
+    double m_sum_of_squares{};
+};
+
+// Calls on_tick every interval, on the event loop. Each tick has a deadline, a whole number of intervals from the first
+// one, so a tick that runs late doesn't push back the ones after it, and the rate doesn't drift. Deadlines are waited
+// for with a timerfd, which has nanosecond resolution (where we don't have one, it falls back to a Core::Timer, which
+// only has milliseconds). If ticks fall behind, they're run back to back until they've caught up, but never more than
+// max_number_of_catch_up_ticks of them. Anything further behind than that is skipped.
+class TickScheduler
+{
+    AK_MAKE_NONCOPYABLE(TickScheduler);
+    AK_MAKE_NONMOVABLE(TickScheduler);
+
+public:
+    static constexpr i64 max_number_of_catch_up_ticks = 5;
+
+    static ErrorOr<NonnullOwnPtr<TickScheduler>> try_create(Time interval, Function<void()> on_tick);
+    ~TickScheduler();
+
+    // The first tick is right away
+    ErrorOr<void> start();
+
+    const FrameTimeStatistics& frame_time_statistics() const { return m_frame_time_statistics; }
+
+private:
+    TickScheduler(int timer_fd, Time interval, Function<void()> on_tick);
+
+    void run_tick();
+    ErrorOr<void> arm();
+
+    int m_timer_fd{-1};
+    RefPtr<Core::Notifier> m_notifier;
+    RefPtr<Core::Timer> m_timer;
+
+    Time m_interval;
+    // If the next deadline is further behind than this, we skip ahead
+    Time m_max_lag;
+    Time m_next_deadline;
+    Optional<Time> m_last_tick_time;
+    Function<void()> m_on_tick;
+    FrameTimeStatistics m_frame_time_statistics;
+};
\ No newline at end of file
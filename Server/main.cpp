@@ -8,6 +8,7 @@
 #include <LibCore/Stream.h>
 #include <LibMain/Main.h>
 #include <LibSourceEngine/BSP.h>
+#include <LibSourceEngine/VPK.h>
 #include <Server/Server.h>
 
 static Server* s_server;
@@ -15,8 +16,15 @@ static Server* s_server;
 ErrorOr<int> serenity_main(Main::Arguments arguments)
 {
     String map_name;
+    String vpk_path;
+    // So that a burst of packets doesn't hold up the tick
+    int number_of_receive_threads = 1;
 
     Core::ArgsParser args_parser;
+    args_parser.add_option(vpk_path, "VPK that clients can download files from", "vpk", 'v', "path");
+    args_parser.add_option(number_of_receive_threads,
+                           "Receive on this many threads, each with their own socket (0 does everything on one thread)",
+                           "receive-threads", 't', "count");
     args_parser.add_positional_argument(map_name, "Name of the map to load", "map-name");
     args_parser.parse(arguments);
 
@@ -24,9 +32,16 @@ ErrorOr<int> serenity_main(Main::Arguments arguments)
         TRY(Core::Stream::File::open(String::formatted("{}.bsp", map_name), Core::Stream::OpenMode::Read));
     auto map = TRY(SourceEngine::BSP::try_parse(*bsp_file_stream));
 
-    s_server = new Server(map_name, move(map));
+    Optional<SourceEngine::VPK> vpk;
+    if (!vpk_path.is_null())
+        vpk = TRY(SourceEngine::VPK::try_parse_from_file_path(vpk_path));
 
-    TRY(s_server->bind({}, 6666));
+    s_server = new Server(map_name, move(map), move(vpk));
+
+    if (number_of_receive_threads < 0)
+        return Error::from_string_literal("Number of receive threads can't be negative");
+
+    TRY(s_server->bind({}, 6666, number_of_receive_threads));
 
     return s_server->exec();
 }
\ No newline at end of file
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2022, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/Array.h>
+#include <AK/ByteBuffer.h>
+#include <AK/Format.h>
+#include <AK/Time.h>
+#include <LibCore/ArgsParser.h>
+#include <LibCrypto/Checksum/CRC32.h>
+#include <LibMain/Main.h>
+#include <LibSourceEngine/CRC32.h>
+
+// Not random in any way that matters, but the same every run, so that a mismatch can be reproduced
+static u32 next_random(u32& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static ErrorOr<bool> check_equivalence(unsigned number_of_checks)
+{
+    constexpr auto check_value = "123456789"sv;
+    constexpr u32 expected_check_value = 0xCBF43926;
+    if (SourceEngine::CRC32(check_value.bytes()).digest() != expected_check_value)
+    {
+        warnln("Check value is {:08x}, expected {:08x}", SourceEngine::CRC32(check_value.bytes()).digest(),
+               expected_check_value);
+        return false;
+    }
+
+    // Room for the largest length at any of the alignments
+    constexpr size_t max_length = 4 * KiB;
+    constexpr size_t max_offset = 16;
+    auto buffer = TRY(ByteBuffer::create_uninitialized(max_length + max_offset));
+
+    u32 random_state = 0x12345678;
+    for (auto& byte : buffer.bytes())
+        byte = static_cast<u8>(next_random(random_state));
+
+    for (unsigned i = 0; i < number_of_checks; i++)
+    {
+        auto offset = next_random(random_state) % max_offset;
+        auto length = next_random(random_state) % (max_length + 1);
+        auto bytes = buffer.bytes().slice(offset, length);
+
+        auto expected = Crypto::Checksum::CRC32(bytes).digest();
+        auto actual = SourceEngine::CRC32(bytes).digest();
+        if (actual != expected)
+        {
+            warnln("{} bytes at offset {}: got {:08x}, expected {:08x}", length, offset, actual, expected);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template<typename Checksum>
+static double gigabytes_per_second(ReadonlyBytes bytes, size_t total_bytes)
+{
+    auto number_of_iterations = max(total_bytes / bytes.size(), static_cast<size_t>(1));
+
+    // Keeps the checksums from being optimized away
+    u32 accumulated = 0;
+    auto start_time = Time::now_monotonic();
+    for (size_t i = 0; i < number_of_iterations; i++)
+        accumulated ^= Checksum(bytes).digest();
+    auto elapsed_time = Time::now_monotonic() - start_time;
+
+    AK::taint_for_optimizer(accumulated);
+    auto elapsed_seconds = static_cast<double>(elapsed_time.to_nanoseconds()) / 1'000'000'000.0;
+    return static_cast<double>(number_of_iterations * bytes.size()) / elapsed_seconds / 1'000'000'000.0;
+}
+
+ErrorOr<int> serenity_main(Main::Arguments arguments)
+{
+    unsigned number_of_checks = 10000;
+    unsigned megabytes_per_size = 256;
+
+    Core::ArgsParser args_parser;
+    args_parser.add_option(number_of_checks, "How many random lengths and alignments to compare", "checks", 'c',
+                           "checks");
+    args_parser.add_option(megabytes_per_size, "How many megabytes to checksum for each size", "megabytes", 'm',
+                           "megabytes");
+    args_parser.parse(arguments);
+
+    if (!TRY(check_equivalence(number_of_checks)))
+        return 1;
+
+    outln("SourceEngine::CRC32 matches Crypto::Checksum::CRC32 for {} random lengths and alignments",
+          number_of_checks);
+
+    // A small packet, one that's as large as we'll send before splitting it, and a VPK entry
+    constexpr Array<size_t, 3> sizes{64, 1400, 64 * KiB};
+    auto buffer = TRY(ByteBuffer::create_zeroed(sizes.last()));
+    auto total_bytes = static_cast<size_t>(megabytes_per_size) * MiB;
+
+    for (auto size : sizes)
+    {
+        auto bytes = buffer.bytes().trim(size);
+        auto crypto = gigabytes_per_second<Crypto::Checksum::CRC32>(bytes, total_bytes);
+        auto source_engine = gigabytes_per_second<SourceEngine::CRC32>(bytes, total_bytes);
+        outln("{:>6} bytes: Crypto::Checksum::CRC32 {:.2} GB/s, SourceEngine::CRC32 {:.2} GB/s ({:.1}x)", size,
+              crypto, source_engine, source_engine / crypto);
+    }
+
+    return 0;
+}
\ No newline at end of file
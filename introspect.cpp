@@ -3,14 +3,19 @@
 #include <LibCore/Stream.h>
 #include <LibCore/UDPServer.h>
 #include <LibMain/Main.h>
+#include <LibSourceEngine/Channel.h>
+#include <LibSourceEngine/DatagramBufferPool.h>
 #include <LibSourceEngine/Message.h>
 #include <LibSourceEngine/Messages/Clientbound/ServerInfo.h>
 #include <LibSourceEngine/Messages/Disconnect.h>
 #include <LibSourceEngine/Messages/SetConVar.h>
 #include <LibSourceEngine/Messages/SignOnState.h>
 #include <LibSourceEngine/Packet.h>
+#include <errno.h>
+#include <sys/socket.h>
 
-static constexpr size_t bytes_to_receive = 2 * MiB;
+// As large as a UDP datagram can be
+static constexpr size_t bytes_to_receive = 64 * KiB;
 
 enum class Side
 {
@@ -25,11 +30,15 @@ static bool describe_serverbound_unreliable_messages{};
 static bool describe_clientbound_reliable_messages{};
 static bool describe_serverbound_reliable_messages{};
 
-ErrorOr<void> process_message(ReadonlyBytes bytes, Side bound, bool reliable)
+// We only ever see one connection, so one set of channels for each direction is enough
+static Array<SourceEngine::ReceivingChannel, SourceEngine::Packet::number_of_channels> clientbound_receiving_channels;
+static Array<SourceEngine::ReceivingChannel, SourceEngine::Packet::number_of_channels> serverbound_receiving_channels;
+
+ErrorOr<void> process_message(SourceEngine::BitSpan data, Side bound, bool reliable)
 {
-    SourceEngine::MemoryBitStream stream(bytes);
+    SourceEngine::MemoryBitStream stream(data);
 
-    while (bytes.size() > (TRY(stream.position()) + SourceEngine::Message::number_of_bits_for_message_id) >> 3)
+    while (stream.size_in_bits() > TRY(stream.position()) + SourceEngine::Message::number_of_bits_for_message_id)
     {
         auto bound_prefix = bound == Side::Client ? 'C' : 'S';
         auto cmd = TRY(stream.read_typed<u8>(6));
@@ -111,7 +120,8 @@ ErrorOr<void> process_packet(Bytes bytes, Side bound)
 
     SourceEngine::MemoryBitStream stream(bytes);
 
-    auto packet = TRY(SourceEngine::ReceivingPacket::read(stream));
+    auto& receiving_channels = bound == Side::Client ? clientbound_receiving_channels : serverbound_receiving_channels;
+    auto packet = TRY(SourceEngine::ReceivingPacket::read(stream, receiving_channels));
     auto challenge_string = packet.challenge().has_value() ? String::formatted("{}", *packet.challenge()) : "(none)";
 
     if ((bound == Side::Client && describe_clientbound_packets) ||
@@ -124,22 +134,18 @@ ErrorOr<void> process_packet(Bytes bytes, Side bound)
     if ((bound == Side::Client && describe_clientbound_unreliable_messages) ||
         (bound == Side::Server && describe_serverbound_unreliable_messages))
     {
-        auto& unreliable_data = packet.unreliable_data();
+        auto unreliable_data = packet.unreliable_data();
 
-        if (unreliable_data.size() > 0)
-            TRY(process_message(unreliable_data.bytes(), bound, false));
+        if (!unreliable_data.is_empty())
+            TRY(process_message(unreliable_data, bound, false));
     }
 
     if ((bound == Side::Client && describe_clientbound_reliable_messages) ||
         (bound == Side::Server && describe_serverbound_reliable_messages))
     {
-        auto& channel_data = packet.channel_data();
-        auto maybe_normal_channel_data_iterator = channel_data.find(SourceEngine::Packet::Channel::Normal);
-        if (maybe_normal_channel_data_iterator != channel_data.end())
-        {
-            auto& normal_channel_data = maybe_normal_channel_data_iterator->value;
-            TRY(process_message(normal_channel_data.data().bytes(), bound, true));
-        }
+        auto& maybe_normal_channel_data = packet.channel_data(SourceEngine::Packet::Channel::Normal);
+        if (maybe_normal_channel_data.has_value())
+            TRY(process_message(maybe_normal_channel_data->data(), bound, true));
     }
 
     return {};
@@ -179,22 +185,37 @@ ErrorOr<int> serenity_main(Main::Arguments arguments)
 
     Optional<sockaddr_in> first_from;
 
+    // Each packet is done with before the next one arrives, so this only ever needs the one buffer
+    SourceEngine::DatagramBufferPool buffer_pool(bytes_to_receive, 1);
+
     introspect_server->on_ready_to_receive = [&] {
+        auto buffer = MUST(buffer_pool.take());
+
+        // UDPServer::receive would allocate a new buffer for every packet
         sockaddr_in from{};
-        auto bytes = introspect_server->receive(bytes_to_receive, from);
+        socklen_t from_length = sizeof(from);
+        auto size = recvfrom(introspect_server->fd(), buffer.bytes().data(), buffer.bytes().size(), 0,
+                             reinterpret_cast<sockaddr*>(&from), &from_length);
+        if (size < 0)
+        {
+            warnln("Failed to receive serverbound packet: {}", Error::from_errno(errno));
+            return;
+        }
+
+        auto bytes = buffer.bytes().trim(size);
 
         if (!first_from.has_value())
             first_from = from;
 
         MUST(destination_socket->write(bytes));
 
-        auto maybe_error = process_packet(bytes.bytes(), Side::Server);
+        auto maybe_error = process_packet(bytes, Side::Server);
         if (maybe_error.is_error())
             warnln("Failed to process serverbound packet: {}", maybe_error.error());
     };
 
     destination_socket->on_ready_to_read = [&] {
-        auto buffer = MUST(ByteBuffer::create_uninitialized(bytes_to_receive));
+        auto buffer = MUST(buffer_pool.take());
         auto buffer_bytes = MUST(destination_socket->read(buffer.bytes()));
         if (!first_from.has_value())
         {